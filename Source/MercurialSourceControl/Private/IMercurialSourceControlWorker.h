@@ -23,6 +23,8 @@
 //-------------------------------------------------------------------------------
 #pragma once
 
+#include "MercurialSourceControlPathTable.h"
+
 namespace MercurialSourceControl {
 
 /** 
@@ -40,15 +42,23 @@ public:
 
 	/**
 	 * Perform the source control operation.
+	 * Any file states obtained by the operation should be published to the command's file
+	 * state cache from within this method.
 	 * @note May be called on another thread.
 	 */
 	virtual bool Execute(class FCommand& InCommand) = 0;
 	
 	/**
 	 * Update the state of any affected items after completion of the operation.
+	 * @param OutChangedFiles The IDs of any files whose state was changed by the operation 
+	 *                        should be appended to this.
+	 * @return true if the operation changed any states (in the file state cache or 
+	 *         otherwise), in which case the provider will notify listeners.
+	 *         Returning true without appending anything to OutChangedFiles indicates that 
+	 *         listeners should assume every state changed.
 	 * @note Always called on the main thread.
 	 */
-	virtual bool UpdateStates() const = 0;
+	virtual bool UpdateStates(TArray<FPathId>& OutChangedFiles) const = 0;
 
 	virtual ~IWorker() = 0 {};
 };
@@ -0,0 +1,170 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlChangelog.h"
+#include "MercurialSourceControlDirstate.h"
+
+namespace MercurialSourceControl {
+
+namespace 
+{
+	/** 
+	 * Each index entry is 64 bytes, all integers are big-endian:
+	 * 6 bytes data offset, 2 bytes flags, 4 bytes compressed length, 4 bytes uncompressed length,
+	 * 4 bytes base revision, 4 bytes link revision, 4 bytes for each parent revision, 
+	 * 20 bytes node ID, and 12 bytes of padding.
+	 * The data offset of the first entry is replaced by the revlog version and flags.
+	 */
+	const int32 IndexEntrySize = 64;
+	const int32 CompressedLengthOffset = 8;
+	const int32 NodeOffset = 32;
+	const uint32 RevlogVersionMask = 0xFFFF;
+	const uint32 RevlogVersion1 = 1;
+	/** Set if the revision data is interleaved with the index entries. */
+	const uint32 RevlogInlineDataFlag = 1 << 16;
+	/** Number of index entries to read at a time when searching backwards. */
+	const int32 EntriesPerChunk = 1024;
+
+	uint32 ReadBigEndianUInt32(const uint8* InBytes)
+	{
+		return (uint32(InBytes[0]) << 24) | (uint32(InBytes[1]) << 16) 
+			| (uint32(InBytes[2]) << 8) | uint32(InBytes[3]);
+	}
+
+	bool IsMatchingEntry(const uint8* InEntry, const uint8* InNode)
+	{
+		return FMemory::Memcmp(InEntry + NodeOffset, InNode, FDirstateParents::NodeSize) == 0;
+	}
+} // unnamed namespace
+
+FString FChangelog::GetIndexFilename(const FString& InRepositoryRoot)
+{
+	// a repository created with "hg share" keeps its history in the source repository
+	FString HgDirectory = InRepositoryRoot + TEXT(".hg");
+	FString SharedPath;
+	if (FFileHelper::LoadFileToString(SharedPath, *(HgDirectory / TEXT("sharedpath"))))
+	{
+		SharedPath.TrimStartAndEndInline();
+		FPaths::NormalizeDirectoryName(SharedPath);
+		// newer versions of hg may store the path relative to the .hg directory
+		if (FPaths::IsRelative(SharedPath))
+		{
+			SharedPath = HgDirectory / SharedPath;
+			FPaths::CollapseRelativeDirectories(SharedPath);
+		}
+		HgDirectory = SharedPath;
+	}
+
+	// repositories created by anything but ancient versions of hg have a store directory
+	const FString StoreIndexFilename = HgDirectory / TEXT("store/00changelog.i");
+	if (FPaths::FileExists(StoreIndexFilename))
+	{
+		return StoreIndexFilename;
+	}
+	return HgDirectory / TEXT("00changelog.i");
+}
+
+bool FChangelog::FindRevision(
+	const FString& InRepositoryRoot, const uint8* InNode, int32& OutRevision
+)
+{
+	const uint8 NullNode[FDirstateParents::NodeSize] = {};
+	if (FMemory::Memcmp(InNode, NullNode, sizeof(NullNode)) == 0)
+	{
+		OutRevision = INDEX_NONE;
+		return true;
+	}
+
+	TUniquePtr<FArchive> Reader(
+		IFileManager::Get().CreateFileReader(*GetIndexFilename(InRepositoryRoot), FILEREAD_Silent)
+	);
+	if (!Reader)
+	{
+		return false;
+	}
+
+	const int64 IndexSize = Reader->TotalSize();
+	uint8 Entry[IndexEntrySize];
+	if (IndexSize < IndexEntrySize)
+	{
+		return false;
+	}
+	Reader->Serialize(Entry, IndexEntrySize);
+	const uint32 Header = ReadBigEndianUInt32(Entry);
+	if (Reader->IsError() || ((Header & RevlogVersionMask) != RevlogVersion1))
+	{
+		return false;
+	}
+
+	if (Header & RevlogInlineDataFlag)
+	{
+		// Small changelogs store each revision's data right after its index entry, so the index
+		// has to be walked from the start. Inline changelogs are only used while they're 
+		// under 128 KiB though, so this doesn't take long.
+		int64 EntryOffset = 0;
+		for (int32 Revision = 0; EntryOffset + IndexEntrySize <= IndexSize; ++Revision)
+		{
+			Reader->Seek(EntryOffset);
+			Reader->Serialize(Entry, IndexEntrySize);
+			if (Reader->IsError())
+			{
+				return false;
+			}
+			if (IsMatchingEntry(Entry, InNode))
+			{
+				OutRevision = Revision;
+				return true;
+			}
+			EntryOffset += IndexEntrySize + ReadBigEndianUInt32(Entry + CompressedLengthOffset);
+		}
+		return false;
+	}
+
+	// the node being looked up is almost always one of the latest revisions, so search backwards
+	const int32 NumRevisions = IndexSize / IndexEntrySize;
+	TArray<uint8> Chunk;
+	for (int32 ChunkEnd = NumRevisions; ChunkEnd > 0; ChunkEnd -= EntriesPerChunk)
+	{
+		const int32 ChunkStart = FMath::Max(0, ChunkEnd - EntriesPerChunk);
+		Chunk.SetNumUninitialized((ChunkEnd - ChunkStart) * IndexEntrySize);
+		Reader->Seek(int64(ChunkStart) * IndexEntrySize);
+		Reader->Serialize(Chunk.GetData(), Chunk.Num());
+		if (Reader->IsError())
+		{
+			return false;
+		}
+		for (int32 Revision = ChunkEnd - 1; Revision >= ChunkStart; --Revision)
+		{
+			if (IsMatchingEntry(Chunk.GetData() + (Revision - ChunkStart) * IndexEntrySize, InNode))
+			{
+				OutRevision = Revision;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+} // namespace MercurialSourceControl
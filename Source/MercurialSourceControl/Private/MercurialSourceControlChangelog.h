@@ -0,0 +1,49 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+namespace MercurialSourceControl {
+
+/** 
+ * Reads the changelog index of a repository directly, without invoking hg.
+ * Only the original revlog format is understood (which is what hg still uses by default).
+ */
+class FChangelog
+{
+public:
+	/**
+	 * Find the local revision number of the given node.
+	 * @param InRepositoryRoot Absolute path to the root of the repository, must end in a '/'.
+	 * @param InNode Binary node ID, FDirstateParents::NodeSize bytes long.
+	 * @param OutRevision Will be set to the local revision number of the node, or -1 if the 
+	 *                    node is the null node.
+	 * @return false if the node isn't in the changelog or the changelog couldn't be read.
+	 */
+	static bool FindRevision(const FString& InRepositoryRoot, const uint8* InNode, int32& OutRevision);
+
+	/** Get the absolute filename of the changelog index of the given repository. */
+	static FString GetIndexFilename(const FString& InRepositoryRoot);
+};
+
+} // namespace MercurialSourceControl
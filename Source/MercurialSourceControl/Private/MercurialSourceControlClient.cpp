@@ -24,57 +24,138 @@
 
 #include "MercurialSourceControlPrivatePCH.h"
 #include "MercurialSourceControlClient.h"
+#include "MercurialSourceControlPathNormalizer.h"
+#include "MercurialSourceControlDirstate.h"
 #include "ISourceControlModule.h"
 #include "XmlParser.h"
 #include "PlatformFilemanager.h"
+#include "MercurialSourceControlProcess.h"
+#include "MercurialSourceControlCommand.h"
+#include "Async/ParallelFor.h"
 #include "WindowsHWrapper.h"
 
 // WinBase.h defines GetUserName conflicting with ISourceControlRevision::GetUserName and leads to obscure errors.
 // The line bellow prevents this error.
 #undef GetUserName
 
+#if !PLATFORM_WINDOWS
+#include <unistd.h>
+
+extern char** environ;
+#endif // !PLATFORM_WINDOWS
+
 namespace MercurialSourceControl {
 
 #define LOCTEXT_NAMESPACE "MercurialSourceControl.Client"
 
 FClientSharedPtr FClient::Singleton;
 
-/** 
- * Creates a temp file on disk that is bound to the lifetime of an FScopedTempFile instance.
- * When an FScopedTempFile instance is destroyed the temp file it created is deleted from disk.
- */
-class FScopedTempFile
+namespace 
 {
-public:
-	FScopedTempFile(const FString& InExtension)
-	: Extension(InExtension)
+	/** 
+	 * Read-only commands on large numbers of files are split into chunks of at least this many
+	 * files, each chunk is processed by a separate hg process.
+	 */
+	const int32 MinFilesPerChunk = 1000;
+
+	/** Maximum number of hg processes to run in parallel for a single chunked command. */
+	const int32 MaxParallelProcesses = 8;
+
+	/** Seconds an interrupted hg process is given to clean up and exit before it's killed. */
+	const double StopGracePeriod = 10.0;
+
+	/** 
+	 * Extensions that are left enabled by the fast profile because they change the outcome of
+	 * the commands the plugin runs, or make them faster.
+	 */
+	const TCHAR* EssentialExtensions[] = {
+		TEXT("largefiles"), TEXT("lfs"), TEXT("eol"), TEXT("keyword"), TEXT("win32text"),
+		TEXT("fsmonitor"), TEXT("hgwatchman"), TEXT("share"), TEXT("sparse"), TEXT("narrow"),
+		TEXT("remotefilelog")
+	};
+
+	/** Strip the package from the name of an extension, e.g. hgext.largefiles -> largefiles. */
+	FString GetShortExtensionName(const FString& InName)
 	{
+		int32 DotIndex = INDEX_NONE;
+		return InName.FindLastChar(TEXT('.'), DotIndex) ? InName.RightChop(DotIndex + 1) : InName;
 	}
 
-	~FScopedTempFile()
+	/** 
+	 * Look for the message hg prints to stderr when the repository is locked by another process
+	 * (e.g. a crashed TortoiseHg), it's printed while hg waits for the lock, and again when hg 
+	 * gives up waiting.
+	 * @return true if the message was found, false otherwise.
+	 */
+	bool FindLockMessage(const FString& InStdError, FString& OutMessage)
 	{
-		if (!Filename.IsEmpty())
+		const int32 Start = InStdError.Find(TEXT("waiting for lock"));
+		if (Start == INDEX_NONE)
 		{
-			IFileManager::Get().Delete(*Filename);
+			return false;
 		}
+		// find the start and end of the line the message is on
+		const int32 LineStart = InStdError.Find(
+			TEXT("\n"), ESearchCase::CaseSensitive, ESearchDir::FromEnd, Start
+		) + 1;
+		int32 LineEnd = InStdError.Find(
+			TEXT("\n"), ESearchCase::CaseSensitive, ESearchDir::FromStart, Start
+		);
+		if (LineEnd == INDEX_NONE)
+		{
+			LineEnd = InStdError.Len();
+		}
+		OutMessage = InStdError.Mid(LineStart, LineEnd - LineStart).TrimEnd();
+		return true;
 	}
 
-	const FString& GetFilename()
+#if !PLATFORM_WINDOWS
+	/** Look for an executable with the given name in each directory on the PATH. */
+	bool FindOnPath(const FString& InName, FString& OutFilename)
 	{
-		if (Filename.IsEmpty())
+		TArray<FString> Directories;
+		FPlatformMisc::GetEnvironmentVariable(TEXT("PATH")).ParseIntoArray(
+			Directories, TEXT(":"), true
+		);
+		for (const FString& Directory : Directories)
 		{
-			FString OutputDir = FPaths::ProjectLogDir();
-			FPaths::NormalizeDirectoryName(OutputDir);
-			Filename = FPaths::CreateTempFilename(*OutputDir, TEXT("hg-"), *Extension);
-			Filename = FPaths::ConvertRelativePathToFull(Filename);
+			const FString Filename = Directory / InName;
+			if (FPaths::FileExists(Filename))
+			{
+				OutFilename = Filename;
+				return true;
+			}
 		}
-		return Filename;
+		return false;
 	}
-
-private:
-	FString Filename;
-	FString Extension;
-};
+#endif // !PLATFORM_WINDOWS
+
+	/**
+	 * Encode a list of filenames the way hg expects to find them in a list file, i.e. in the 
+	 * encoding hg uses for filenames, which on Windows is always the system's default code page. 
+	 * For future reference:
+	 * http://mercurial.selenic.com/wiki/EncodingStrategy
+	 * http://en.it-usenet.org/thread/16853/40385/
+	 */
+	TArray<uint8> EncodeFileList(const FString& InFileList)
+	{
+		TArray<uint8> Bytes;
+#if PLATFORM_WINDOWS
+		const int32 NumBytes = ::WideCharToMultiByte(
+			CP_ACP, 0, *InFileList, InFileList.Len(), nullptr, 0, nullptr, nullptr
+		);
+		Bytes.SetNumUninitialized(NumBytes);
+		::WideCharToMultiByte(
+			CP_ACP, 0, *InFileList, InFileList.Len(), (LPSTR)Bytes.GetData(), NumBytes, 
+			nullptr, nullptr
+		);
+#else
+		FTCHARToUTF8 Converter(*InFileList, InFileList.Len());
+		Bytes.Append((const uint8*)Converter.Get(), Converter.Length());
+#endif // PLATFORM_WINDOWS
+		return Bytes;
+	}
+} // unnamed namespace
 
 bool FClient::IsValidExecutable(const FString& InFilename)
 {
@@ -91,6 +172,16 @@ bool FClient::IsValidExecutable(const FString& InFilename)
 }
 
 bool FClient::FindExecutable(FString& OutFilename)
+{
+	if (LocateExecutable(OutFilename) && IsValidExecutable(OutFilename))
+	{
+		return true;
+	}
+	OutFilename.Empty();
+	return false;
+}
+
+bool FClient::LocateExecutable(FString& OutFilename)
 {
 	OutFilename.Empty();
 
@@ -104,35 +195,96 @@ bool FClient::FindExecutable(FString& OutFilename)
 		FPlatformMisc::QueryRegKey(HKEY_LOCAL_MACHINE, SubKey, ValueName, HgPath))
 	{
 		HgPath /= TEXT("hg.exe");
-		if (IsValidExecutable(HgPath))
+		if (FPaths::FileExists(HgPath))
 		{
 			OutFilename = HgPath;
 		}
 	}
+#else
+	// hg is usually installed by the system's package manager, or pip
+	FindOnPath(TEXT("hg"), OutFilename);
 #endif // PLATFORM_WINDOWS
 
 	return !OutFilename.IsEmpty();
 }
 
-bool FClient::Create(const FString& InMercurialPath, FText& OutError)
+bool FClient::LocateChg(const FString& InMercurialPath, FString& OutChgPath)
+{
+	OutChgPath.Empty();
+
+#if !PLATFORM_WINDOWS
+	// if the user pointed the plugin at chg there's nothing more to find
+	if (FPaths::GetCleanFilename(InMercurialPath) == TEXT("chg"))
+	{
+		return false;
+	}
+
+	// chg is normally installed alongside hg, but any chg will do since it's told which hg 
+	// to run the command server with
+	const FString SiblingPath = FPaths::GetPath(InMercurialPath) / TEXT("chg");
+	if (FPaths::FileExists(SiblingPath))
+	{
+		OutChgPath = SiblingPath;
+	}
+	else
+	{
+		FindOnPath(TEXT("chg"), OutChgPath);
+	}
+#endif // !PLATFORM_WINDOWS
+
+	return !OutChgPath.IsEmpty();
+}
+
+void FClient::Create(
+	const FString& InMercurialPath, const FTimeoutPolicy& InTimeoutPolicy, bool bInPreferChg,
+	bool bInFastProfile, const FString& InRepositoryRoot
+)
 {
-	if (ensure(!Singleton.IsValid()))
+	if (!ensure(!Singleton.IsValid()))
 	{
-		FString ExePath = InMercurialPath;
+		return;
+	}
 
-		bool bExeFound = ExePath.IsEmpty() ? 
-			FClient::FindExecutable(ExePath) : FClient::IsValidExecutable(ExePath);
-		
-		if (bExeFound)
+	FClientSharedPtr Client = MakeShareable(new FClient(InMercurialPath, InTimeoutPolicy));
+	FString ChgPath;
+	if (bInPreferChg && LocateChg(InMercurialPath, ChgPath))
+	{
+		if (Client->IsChgHealthy(ChgPath))
 		{
-			Singleton = MakeShareable(new FClient(ExePath));
+			UE_LOG(LogSourceControl, Log, TEXT("Running hg through %s"), *ChgPath);
+			Client->ChgExecutablePath = ChgPath;
+			Client->MaxCommandLineLength = FMath::Min(
+				Client->MaxCommandLineLength, 
+				GetMaxCommandLineLength(ChgPath) - Client->GlobalOptions.Len()
+			);
 		}
 		else
 		{
-			OutError = LOCTEXT("ExeNotFound", "Failed to locate a valid Mercurial executable.");
+			UE_LOG(
+				LogSourceControl, Warning, 
+				TEXT("%s failed its health check, hg will be run directly."), *ChgPath
+			);
 		}
 	}
-	return Singleton.IsValid();
+	// the client must be fully configured before other threads can get hold of it
+	if (bInFastProfile)
+	{
+		Client->EnableFastProfile(InRepositoryRoot);
+	}
+	Singleton = Client;
+}
+
+FClient::FClient(const FString& InMercurialPath, const FTimeoutPolicy& InTimeoutPolicy)
+	: MercurialExecutablePath(InMercurialPath)
+	, TimeoutPolicy(InTimeoutPolicy)
+	, bFastProfile(false)
+	, bChgFailed(0)
+{
+	// hg waits 10 minutes for a lock by default, it's better to give up early and retry
+	GlobalOptions = FString::Printf(
+		TEXT("--config ui.timeout=%d "), FMath::Max(TimeoutPolicy.LockTimeout, 0)
+	);
+	MaxCommandLineLength = GetMaxCommandLineLength(InMercurialPath) - GlobalOptions.Len();
 }
 
 const FClientSharedPtr& FClient::Get()
@@ -145,18 +297,25 @@ void FClient::Destroy()
 	Singleton.Reset();
 }
 
-bool FClient::GetRepositoryRoot(const FString& InWorkingDirectory, FString& OutRepositoryRoot) const
+bool FClient::GetRepositoryRoot(const FString& InWorkingDirectory, FString& OutRepositoryRoot)
 {
-	FString Output;
-	TArray<FString> None;
-	TArray<FString> Errors;
-	if (RunCommand(TEXT("root"), None, InWorkingDirectory, None, false, Output, Errors))
-	{
-		Output.RemoveFromEnd(TEXT("\n"));
-		OutRepositoryRoot = Output;
-		FPaths::NormalizeDirectoryName(OutRepositoryRoot);
-		OutRepositoryRoot += TEXT("/");
-		return true;
+	// same search as "hg root" does, walk up the directory tree until a .hg directory is found
+	FString Directory = InWorkingDirectory;
+	FPaths::NormalizeDirectoryName(Directory);
+	while (!Directory.IsEmpty())
+	{
+		if (IFileManager::Get().DirectoryExists(*(Directory / TEXT(".hg"))))
+		{
+			OutRepositoryRoot = Directory + TEXT("/");
+			return true;
+		}
+
+		int32 SeparatorIndex = INDEX_NONE;
+		if (!Directory.FindLastChar(TEXT('/'), SeparatorIndex))
+		{
+			break;
+		}
+		Directory.RemoveAt(SeparatorIndex, Directory.Len() - SeparatorIndex);
 	}
 	return false;
 }
@@ -167,6 +326,7 @@ bool FClient::GetFileStates(
 ) const
 {
 	TArray<FString> RelativeFiles;
+	RelativeFiles.Reserve(InAbsoluteFiles.Num());
 	// convert absolute paths to be relative to the working directory
 	for (const auto& AbsoluteFilename : InAbsoluteFiles)
 	{
@@ -175,10 +335,10 @@ bool FClient::GetFileStates(
 		//       and if the end user creates their project on a different drive to the one the 
 		//       engine is installed on those paths can't be converted to be relative to the 
 		//       project's repository working directory.
-		FString Filename = AbsoluteFilename;
-		if (FPaths::MakePathRelativeTo(Filename, *InWorkingDirectory))
+		FString Filename;
+		if (FPathNormalizer::ToRelative(InWorkingDirectory, AbsoluteFilename, Filename))
 		{
-			RelativeFiles.Add(Filename);
+			RelativeFiles.Add(MoveTemp(Filename));
 		}
 	}
 	
@@ -187,30 +347,199 @@ bool FClient::GetFileStates(
 		return true;
 	}
 
+	// If the ignore rules can be matched natively hg doesn't need to look for unknown and 
+	// ignored files, which saves it from walking huge ignored directories like Intermediate.
+	const FIgnoreMatcherPtr Matcher = GetIgnoreMatcher(InWorkingDirectory);
 	TArray<FString> Options;
-	// show all modified, added, removed, deleted, unknown, clean, and ignored files
-	Options.Add(TEXT("-marduci"));
-	FString Output;
+	// show all modified, added, removed, deleted, clean (and maybe unknown and ignored) files
+	Options.Add(Matcher.IsValid() ? TEXT("-mardc") : TEXT("-marduci"));
+	TArray<FString> Outputs;
+	TSet<FString> TrackedFiles;
 	
-	if (RunCommand(TEXT("status"), Options, InWorkingDirectory, RelativeFiles, false, Output, OutErrors))
+	if (RunChunkedCommand(TEXT("status"), Options, InWorkingDirectory, RelativeFiles, Outputs, OutErrors))
 	{
 		TArray<FString> Lines;
-		Output.ParseIntoArray(Lines, TEXT("\n"), true);
+		for (const auto& Output : Outputs)
+		{
+			TArray<FString> ChunkLines;
+			Output.ParseIntoArray(ChunkLines, TEXT("\n"), true);
+			Lines.Append(MoveTemp(ChunkLines));
+		}
 		for (const auto& Line : Lines)
 		{
 			// each line consists of a one character status code followed by a filename, 
-			// a single space separates the status code from the filename
+			// a single space separates the status code from the filename, anything else
+			// isn't a status line
+			const EFileStatus FileStatus = 
+				(Line.Len() > 2) && (Line[1] == TEXT(' ')) ? 
+				StatusCodeToFileStatus(Line[0]) : EFileStatus::Unknown;
+			if (FileStatus == EFileStatus::Unknown)
+			{
+				continue;
+			}
 			FString Filename = Line.RightChop(2);
 			FPaths::NormalizeFilename(Filename);
 			FFileState FileState(InWorkingDirectory / Filename);
-			FileState.SetFileStatus(StatusCodeToFileStatus(Line[0]));
+			FileState.SetFileStatus(FileStatus);
 			OutFileStates.Add(FileState);
+			if (Matcher.IsValid())
+			{
+				TrackedFiles.Add(MoveTemp(Filename));
+			}
+		}
+		if (Matcher.IsValid())
+		{
+			GetUntrackedFileStates(
+				Matcher->GetRepositoryRoot(), RelativeFiles, *Matcher, TrackedFiles, OutFileStates
+			);
 		}
 		return true;
 	}
 	return false;
 }
 
+FIgnoreMatcherPtr FClient::GetIgnoreMatcher(const FString& InWorkingDirectory) const
+{
+	// the matcher deals in paths relative to the repository root, which is normally the 
+	// working directory anyway
+	FString WorkingDirectory = InWorkingDirectory;
+	if (!WorkingDirectory.EndsWith(TEXT("/")))
+	{
+		WorkingDirectory += TEXT("/");
+	}
+	FString RepositoryRoot;
+	if (!GetRepositoryRoot(InWorkingDirectory, RepositoryRoot) || 
+		(RepositoryRoot != WorkingDirectory))
+	{
+		return nullptr;
+	}
+
+	FScopeLock ScopeLock(&IgnoreMatcherCriticalSection);
+	if (!IgnoreMatcher.IsValid() || (IgnoreMatcher->GetRepositoryRoot() != RepositoryRoot) || 
+		IgnoreMatcher->IsOutOfDate())
+	{
+		TArray<FString> IgnoreFiles;
+		TArray<FString> ErrorMessages;
+		if (!GetIgnoreFiles(RepositoryRoot, IgnoreFiles, ErrorMessages))
+		{
+			return nullptr;
+		}
+		IgnoreMatcher = FIgnoreMatcher::Compile(RepositoryRoot, IgnoreFiles);
+	}
+	return IgnoreMatcher->IsValid() ? IgnoreMatcher : nullptr;
+}
+
+bool FClient::GetIgnoreFiles(
+	const FString& InRepositoryRoot, TArray<FString>& OutIgnoreFiles, TArray<FString>& OutErrors
+) const
+{
+	FString Output;
+	const FString Command = FString::Printf(
+		TEXT("config ui -y --cwd %s"), *QuoteFilename(InRepositoryRoot)
+	);
+	if (!RunCommand(Command, Output, OutErrors))
+	{
+		// hg config fails when nothing matches, i.e. when the ui section is empty
+		return OutErrors.Num() == 0;
+	}
+
+	// each line looks like ui.ignore=path or ui.ignore.name=path
+	TArray<FString> Lines;
+	Output.ParseIntoArrayLines(Lines);
+	for (const FString& Line : Lines)
+	{
+		FString Name;
+		FString Path;
+		if (Line.Split(TEXT("="), &Name, &Path) && 
+			((Name == TEXT("ui.ignore")) || Name.StartsWith(TEXT("ui.ignore."))) && 
+			!Path.IsEmpty())
+		{
+			OutIgnoreFiles.Add(Path);
+		}
+	}
+	return true;
+}
+
+void FClient::GetUntrackedFileStates(
+	const FString& InRepositoryRoot, const TArray<FString>& InRelativeFiles, 
+	const FIgnoreMatcher& InIgnoreMatcher, const TSet<FString>& InTrackedFiles,
+	TArray<FFileState>& OutFileStates
+)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	auto AddFileState = [&InRepositoryRoot, &OutFileStates](const FString& InFile, bool bIgnored)
+	{
+		FFileState FileState(InRepositoryRoot + InFile);
+		FileState.SetFileStatus(bIgnored ? EFileStatus::Ignored : EFileStatus::NotTracked);
+		OutFileStates.Add(FileState);
+	};
+	// hg treats a repository nested inside another one as opaque, and so must we
+	auto IsNestedRepository = [&PlatformFile](const FString& InAbsoluteDirectory)
+	{
+		return PlatformFile.DirectoryExists(*(InAbsoluteDirectory / TEXT(".hg")));
+	};
+
+	// directories to walk, along with whether everything in them is ignored
+	TArray<TPair<FString, bool>> Directories;
+	for (const FString& RelativeFile : InRelativeFiles)
+	{
+		FString Path = RelativeFile;
+		Path.RemoveFromEnd(TEXT("/"));
+		if (Path == TEXT("."))
+		{
+			Path.Empty();
+		}
+		const FString AbsolutePath = InRepositoryRoot + Path;
+		if (Path.IsEmpty())
+		{
+			Directories.Emplace(Path, false);
+		}
+		else if (PlatformFile.DirectoryExists(*AbsolutePath))
+		{
+			if (!IsNestedRepository(AbsolutePath))
+			{
+				Directories.Emplace(Path, InIgnoreMatcher.IsIgnored(Path));
+			}
+		}
+		else if (!InTrackedFiles.Contains(Path) && PlatformFile.FileExists(*AbsolutePath))
+		{
+			AddFileState(Path, InIgnoreMatcher.IsIgnored(Path));
+		}
+	}
+
+	while (Directories.Num() > 0)
+	{
+		const TPair<FString, bool> Directory = Directories.Pop(false);
+		FString AbsoluteDirectory = InRepositoryRoot + Directory.Key;
+		AbsoluteDirectory.RemoveFromEnd(TEXT("/"));
+		PlatformFile.IterateDirectory(*AbsoluteDirectory,
+			[&](const TCHAR* InPath, bool bIsDirectory)
+			{
+				const FString Name = FPaths::GetCleanFilename(InPath);
+				const FString Path = Directory.Key.IsEmpty() ? Name : Directory.Key / Name;
+				// the matcher only needs to look at the path itself, since the directory 
+				// containing it has already been matched
+				const bool bIgnored = Directory.Value || InIgnoreMatcher.Matches(Path);
+				if (bIsDirectory)
+				{
+					// ignored directories that weren't asked for are the whole point of 
+					// not asking hg about untracked files, they're never walked
+					if ((Directory.Value || !bIgnored) && (Path != TEXT(".hg")) && 
+						!IsNestedRepository(InPath))
+					{
+						Directories.Emplace(Path, bIgnored);
+					}
+				}
+				else if (!InTrackedFiles.Contains(Path))
+				{
+					AddFileState(Path, bIgnored);
+				}
+				return true;
+			}
+		);
+	}
+}
+
 bool FClient::GetFileHistory(
 	const FString& InWorkingDirectory, const TArray<FString>& InAbsoluteFiles,
 	TMap<FString, TArray<FFileRevisionRef> >& OutFileRevisionsMap, TArray<FString>& OutErrors
@@ -223,37 +552,55 @@ bool FClient::GetFileHistory(
 		return false;
 	}
 
-	bool bResult = true;
 	TArray<FString> Options;
 	Options.Add(TEXT("--encoding utf-8"));
 	Options.Add(TEXT("--style xml"));
 	// verbose: all changes and full commit messages
 	Options.Add(TEXT("-v"));
-	FXmlFile XmlFile;
 
-	for (const auto& RelativeFile : RelativeFiles)
-	{
-		FString Output;
-		if (RunCommand(TEXT("log"), Options, InWorkingDirectory, RelativeFile, Output, OutErrors))
+	// hg log is run for each file separately, but the files don't depend on each other so 
+	// a few of them can be processed at the same time, the results are merged in order afterwards
+	TArray<TArray<FFileRevisionRef>> FileRevisionsPerFile;
+	TArray<TArray<FString>> ErrorsPerFile;
+	TArray<bool> ResultPerFile;
+	FileRevisionsPerFile.SetNum(RelativeFiles.Num());
+	ErrorsPerFile.SetNum(RelativeFiles.Num());
+	ResultPerFile.SetNumZeroed(RelativeFiles.Num());
+
+	FCommand* Command = FCommand::GetCurrent();
+	ParallelFor(RelativeFiles.Num(),
+		[&](int32 Index)
 		{
-			if (XmlFile.LoadFile(Output, EConstructMethod::ConstructFromBuffer))
+			FCommand::FScopedCurrent ScopedCommand(Command);
+			const FString& RelativeFile = RelativeFiles[Index];
+			FString Output;
+			ResultPerFile[Index] = RunCommand(
+				TEXT("log"), Options, InWorkingDirectory, RelativeFile, Output, ErrorsPerFile[Index]
+			);
+			FXmlFile XmlFile;
+			if (ResultPerFile[Index] && 
+				XmlFile.LoadFile(Output, EConstructMethod::ConstructFromBuffer))
 			{
-				TArray<FFileRevisionRef> FileRevisions;
-				GetFileRevisionsFromXml(RelativeFile, XmlFile, FileRevisions);
-				if (FileRevisions.Num() > 0)
-				{
-					FString AbsoluteFile = InWorkingDirectory / RelativeFile;
-					for (const auto& Revision : FileRevisions)
-					{
-						Revision->SetFilename(AbsoluteFile);
-					}
-					OutFileRevisionsMap.Add(AbsoluteFile, FileRevisions);
-				}
+				GetFileRevisionsFromXml(RelativeFile, XmlFile, FileRevisionsPerFile[Index]);
 			}
 		}
-		else
+	);
+
+	bool bResult = true;
+	for (int32 i = 0; i < RelativeFiles.Num(); ++i)
+	{
+		OutErrors.Append(ErrorsPerFile[i]);
+		bResult &= ResultPerFile[i];
+
+		const TArray<FFileRevisionRef>& FileRevisions = FileRevisionsPerFile[i];
+		if (FileRevisions.Num() > 0)
 		{
-			bResult = false;
+			FString AbsoluteFile = InWorkingDirectory / RelativeFiles[i];
+			for (const auto& Revision : FileRevisions)
+			{
+				Revision->SetFilename(AbsoluteFile);
+			}
+			OutFileRevisionsMap.Add(AbsoluteFile, FileRevisions);
 		}
 	}
 	return bResult;
@@ -264,8 +611,8 @@ bool FClient::ExtractFileFromRevision(
 	const FString& InDestinationFile, TArray<FString>& OutErrors
 ) const
 {
-	FString Filename = InFileToExtract;
-	if (!FPaths::MakePathRelativeTo(Filename, *InWorkingDirectory))
+	FString Filename;
+	if (!FPathNormalizer::ToRelative(InWorkingDirectory, InFileToExtract, Filename))
 	{
 		return false;
 	}
@@ -323,28 +670,9 @@ bool FClient::RevertFiles(
 	);
 }
 
-bool FClient::RemoveFiles(
-	const FString& InWorkingDirectory, const TArray<FString>& InAbsoluteFiles,
-	TArray<FString>& OutErrors
-) const
-{
-	TArray<FString> RelativeFiles;
-	if (!ConvertFilesToRelative(InWorkingDirectory, InAbsoluteFiles, RelativeFiles))
-	{
-		return false;
-	}
-
-	TArray<FString> Options;
-	FString Output;
-
-	return RunCommand(
-		TEXT("remove"), Options, InWorkingDirectory, RelativeFiles, false, Output, OutErrors
-	);
-}
-
 bool FClient::RemoveAllFiles(
-	const FString& InWorkingDirectory, const TArray<FString>& InAbsoluteFiles,
-	TArray<FString>& OutErrors
+	const FString& InWorkingDirectory, const TArray<FFileState>& InFileStates,
+	TArray<FRemoveFileResult>& OutResults, TArray<FString>& OutErrors
 ) const
 {
 	// The idea here is to emulate the functionality of "svn delete", which works slightly
@@ -352,61 +680,131 @@ bool FClient::RemoveAllFiles(
 	// "added" from the disk, but HG will not (it expects you to use "hg forget" first and then
 	// delete the file from disk manually).
 
-	// first we need to figure out what the status of each file we need to remove is
+	// The caller usually knows the status of each file already, so hg only needs to be asked 
+	// about the ones it doesn't know. Files that are supposedly added are asked about anyway, 
+	// they're going to be deleted from disk without hg getting a say in it, so a stale status
+	// mustn't be trusted (the file may have been committed and modified since).
 	TArray<FFileState> FileStates;
-	if (!GetFileStates(InWorkingDirectory, InAbsoluteFiles, FileStates, OutErrors))
+	FileStates.Reserve(InFileStates.Num());
+	TArray<FString> FilesToQuery;
+	for (const auto& FileState : InFileStates)
+	{
+		const EFileStatus Status = FileState.GetFileStatus();
+		if ((Status == EFileStatus::Unknown) || (Status == EFileStatus::Added))
+		{
+			FileState.GetFilename(FilesToQuery[FilesToQuery.AddDefaulted()]);
+		}
+		else
+		{
+			FileStates.Add(FileState);
+		}
+	}
+	if ((FilesToQuery.Num() > 0) 
+		&& !GetFileStates(InWorkingDirectory, FilesToQuery, FileStates, OutErrors))
 	{
 		return false;
 	}
 
-	// now we can split out the "added" files that need special handling from the rest
 	TArray<FString> AddedFiles;
-	TArray<FString> RemovableFiles;
+	TArray<FString> TrackedFiles;
+	OutResults.Reserve(OutResults.Num() + FileStates.Num());
+	const int32 FirstResult = OutResults.Num();
 	for (const auto& FileState : FileStates)
 	{
-		switch (FileState.GetFileStatus())
+		FRemoveFileResult Result;
+		FileState.GetFilename(Result.Filename);
+		Result.OldStatus = FileState.GetFileStatus();
+		Result.bRemoved = false;
+		switch (Result.OldStatus)
 		{
 			case EFileStatus::Added:
-				AddedFiles.Add(FileState.GetFilename());
+				AddedFiles.Add(Result.Filename);
 				break;
 
 			case EFileStatus::Clean:
 			case EFileStatus::Missing:
-				RemovableFiles.Add(FileState.GetFilename());
+				TrackedFiles.Add(Result.Filename);
 				break;
 		}
+		OutResults.Add(Result);
 	}
 
+	// "hg forget" leaves the added files on disk, they're deleted below
 	bool bResult = true;
+	bool bForgotAddedFiles = true;
+	TArray<FString> Options;
+	FString Output;
+	TArray<FString> RelativeFiles;
+	if ((AddedFiles.Num() > 0) 
+		&& ConvertFilesToRelative(InWorkingDirectory, AddedFiles, RelativeFiles))
+	{
+		bForgotAddedFiles = RunCommand(
+			TEXT("forget"), Options, InWorkingDirectory, RelativeFiles, false, Output, OutErrors
+		);
+		bResult &= bForgotAddedFiles;
+	}
 
-	// forget and delete added files
-	if (AddedFiles.Num() > 0)
+	// "hg remove" (without --force) refuses to remove any files that have been modified since 
+	// their status was cached, so no edits can be lost
+	TSet<FString> RefusedFiles;
+	RelativeFiles.Reset();
+	if ((TrackedFiles.Num() > 0) 
+		&& ConvertFilesToRelative(InWorkingDirectory, TrackedFiles, RelativeFiles))
 	{
-		TArray<FString> RelativeFiles;
-		if (!ConvertFilesToRelative(InWorkingDirectory, AddedFiles, RelativeFiles))
+		TArray<FString> RemoveErrors;
+		if (!RunCommand(
+			TEXT("remove"), Options, InWorkingDirectory, RelativeFiles, false, Output, 
+			RemoveErrors))
 		{
-			return false;
+			bResult = false;
+			for (const FString& Error : RemoveErrors)
+			{
+				// e.g. "not removing Foo.uasset: file is modified (use -f to force removal)"
+				FString Filename;
+				if (Error.Split(TEXT(": "), &Filename, nullptr) 
+					&& Filename.RemoveFromStart(TEXT("not removing ")))
+				{
+					FPaths::NormalizeFilename(Filename);
+					RefusedFiles.Add(InWorkingDirectory / Filename);
+				}
+			}
+			// if hg didn't say which files it refused to remove assume it removed none of them
+			if (RefusedFiles.Num() == 0)
+			{
+				RefusedFiles.Append(TrackedFiles);
+			}
 		}
-			
-		TArray<FString> Options;
-		FString Output;
+		OutErrors.Append(RemoveErrors);
+	}
 
-		bResult &= RunCommand(
-			TEXT("forget"), Options, InWorkingDirectory, RelativeFiles, false, Output, OutErrors
-		);
-		
-		for (const auto& Filename : AddedFiles)
+	ParallelFor(OutResults.Num() - FirstResult, 
+		[&OutResults, FirstResult, bForgotAddedFiles, &RefusedFiles](int32 Index)
 		{
-			bResult &= IFileManager::Get().Delete(*Filename);
+			FRemoveFileResult& Result = OutResults[FirstResult + Index];
+			switch (Result.OldStatus)
+			{
+				case EFileStatus::Added:
+					Result.bRemoved = bForgotAddedFiles && 
+						IFileManager::Get().Delete(*Result.Filename);
+					break;
+
+				case EFileStatus::Clean:
+				case EFileStatus::Missing:
+					Result.bRemoved = !RefusedFiles.Contains(Result.Filename);
+					break;
+			}
 		}
-	}
-	
-	// remove any other removable files
-	if (RemovableFiles.Num() > 0)
+	);
+
+	for (int32 i = FirstResult; i < OutResults.Num(); ++i)
 	{
-		bResult &= RemoveFiles(InWorkingDirectory, RemovableFiles, OutErrors);
+		const FRemoveFileResult& Result = OutResults[i];
+		if (bForgotAddedFiles && (Result.OldStatus == EFileStatus::Added) && !Result.bRemoved)
+		{
+			OutErrors.Add(FString::Printf(TEXT("Failed to delete %s"), *Result.Filename));
+			bResult = false;
+		}
 	}
-
 	return bResult;
 }
 
@@ -421,40 +819,63 @@ bool FClient::CommitFiles(
 		return false;
 	}
 
-	auto Encoding = FCString::IsPureAnsi(*InCommitMessage) ? 
-		FFileHelper::EEncodingOptions::ForceAnsi : FFileHelper::EEncodingOptions::ForceUTF8;
+	// the message is piped to hg through stdin, so there's no need for a temp file
+	FProcess Process;
+	FTCHARToUTF8 Converter(*InCommitMessage, InCommitMessage.Len());
+	TArray<uint8> Message;
+	Message.Append((const uint8*)Converter.Get(), Converter.Length());
+	Process.SetStdin(MoveTemp(Message));
+
+	TArray<FString> Options;
+	Options.Add(FString(TEXT("--encoding utf-8")));
+	Options.Add(FString(TEXT("--logfile -")));
+	FString Output;
 
-	// write the commit message to a temp file
-	FScopedTempFile CommitMessageFile(TEXT(".txt"));
-	bool bResult = FFileHelper::SaveStringToFile(
-		InCommitMessage, *CommitMessageFile.GetFilename(), Encoding
+	return RunCommand(
+		Process, TEXT("commit"), Options, InWorkingDirectory, RelativeFiles, false, Output, 
+		OutErrors
 	);
+}
 
-	if (!bResult)
+bool FClient::GetTrackedFiles(
+	const FString& InRepositoryRoot, TArray<FString>& OutFiles, TArray<FString>& OutErrors
+) const
+{
+	if (FDirstate::ReadTrackedFiles(InRepositoryRoot, OutFiles))
 	{
-		OutErrors.Add(FString::Printf(
-			TEXT("Failed to write to temp file: %s"), *CommitMessageFile.GetFilename()
-		));
-		return false;
+		return true;
 	}
+	OutFiles.Reset();
 
-	TArray<FString> Options;
-	if (Encoding == FFileHelper::EEncodingOptions::ForceUTF8)
-	{
-		Options.Add(FString(TEXT("--encoding utf-8")));
-	}
-	Options.Add(FString(TEXT("--logfile ")) + QuoteFilename(CommitMessageFile.GetFilename()));
 	FString Output;
-
-	return RunCommand(
-		TEXT("commit"), Options, InWorkingDirectory, RelativeFiles, true, Output, OutErrors
+	const FString Command = FString::Printf(
+		TEXT("files --encoding utf-8 -y --cwd %s"), *QuoteFilename(InRepositoryRoot)
 	);
+	if (!RunCommand(Command, Output, OutErrors))
+	{
+		// hg files fails when there are no files to list
+		return OutErrors.Num() == 0;
+	}
+	Output.ParseIntoArrayLines(OutFiles);
+	for (FString& Filename : OutFiles)
+	{
+		FPaths::NormalizeFilename(Filename);
+	}
+	return true;
 }
 
 bool FClient::GetWorkingDirectoryParentRevisionID(
 	const FString& InWorkingDirectory, FString& OutRevisionID, TArray<FString>& OutErrors
 ) const
 {
+	// no need to invoke hg when the working directory is the repository root
+	int32 Revision = INDEX_NONE;
+	if (FDirstate::ReadFirstParentRevision(InWorkingDirectory, Revision))
+	{
+		OutRevisionID = FString::FromInt(Revision);
+		return true;
+	}
+
 	TArray<FString> Options;
 	// just grab the local revision number
 	Options.Add(FString(TEXT("--template \"{rev}\"")));
@@ -497,6 +918,260 @@ void FClient::AppendCommandFiles(FString& InOutCommand, const TArray<FString>& I
 	}
 }
 
+int32 FClient::GetMaxCommandLineLength(const FString& InExecutable)
+{
+#if PLATFORM_WINDOWS
+	// CreateProcess() accepts up to 32767 characters, including the quoted executable path 
+	// and the terminating null
+	return 32767 - (InExecutable.Len() + 3) - 1;
+#else
+	// the arguments share this space with the environment, and each argument also costs 
+	// a pointer and a terminating null on top of its length
+	int64 ArgMax = sysconf(_SC_ARG_MAX);
+	if (ArgMax <= 0)
+	{
+		ArgMax = _POSIX_ARG_MAX;
+	}
+	for (char** Variable = environ; *Variable; ++Variable)
+	{
+		ArgMax -= FCStringAnsi::Strlen(*Variable) + 1 + sizeof(char*);
+	}
+	// leave some room for the per-argument overhead, and for the environment to grow a little
+	// before hg is launched
+	ArgMax /= 2;
+	// the length is measured in characters, but hg receives UTF-8 which may take up to 
+	// 3 bytes per character in the Basic Multilingual Plane
+	ArgMax /= 3;
+	return (int32)FMath::Clamp<int64>(ArgMax - InExecutable.Len(), 1024, MAX_int32);
+#endif // PLATFORM_WINDOWS
+}
+
+void FClient::EnableFastProfile(const FString& InRepositoryRoot)
+{
+	TArray<FString> EnabledExtensions;
+	TArray<FString> ErrorMessages;
+	if (!GetEnabledExtensions(InRepositoryRoot, EnabledExtensions, ErrorMessages))
+	{
+		UE_LOG(
+			LogSourceControl, Warning, 
+			TEXT("Failed to list the enabled Mercurial extensions, the fast profile won't be used.")
+		);
+		return;
+	}
+
+	// extensions named in the repository's requirements are needed to read the repository
+	TArray<FString> Requirements;
+	FFileHelper::LoadFileToStringArray(Requirements, *(InRepositoryRoot + TEXT(".hg/requires")));
+
+	FString DisabledExtensions;
+	for (const FString& Extension : EnabledExtensions)
+	{
+		const FString ShortName = GetShortExtensionName(Extension);
+		bool bIsEssential = Requirements.Contains(ShortName);
+		for (const TCHAR* EssentialExtension : EssentialExtensions)
+		{
+			bIsEssential |= (ShortName == EssentialExtension);
+		}
+		if (!bIsEssential)
+		{
+			DisabledExtensions += FString::Printf(TEXT("--config extensions.%s=! "), *Extension);
+		}
+	}
+
+	UE_LOG(
+		LogSourceControl, Log, 
+		TEXT("Using the fast hg profile, extensions disabled for read-only commands: %s"), 
+		DisabledExtensions.IsEmpty() ? TEXT("none") : *DisabledExtensions
+	);
+	FastProfileOptions = DisabledExtensions;
+	MaxCommandLineLength -= DisabledExtensions.Len();
+	bFastProfile = true;
+}
+
+void FClient::MeasureExtensionCosts(
+	const FString& InRepositoryRoot, int32 InNumSamples, double& OutBaseline,
+	TArray<TPair<FString, double> >& OutCosts
+) const
+{
+	TArray<FString> EnabledExtensions;
+	TArray<FString> ErrorMessages;
+	GetEnabledExtensions(InRepositoryRoot, EnabledExtensions, ErrorMessages);
+
+	// hg root is about as cheap as a command that loads the repository can be, so it's mostly 
+	// startup time, including the time it takes to set up every extension
+	auto TimeCommand = [this, &InRepositoryRoot, InNumSamples](const FString& InOptions)
+	{
+		const FString Arguments = FString::Printf(
+			TEXT("%sroot -y --cwd %s"), *InOptions, *QuoteFilename(InRepositoryRoot)
+		);
+		double BestTime = DBL_MAX;
+		for (int32 Sample = 0; Sample < FMath::Max(InNumSamples, 1); ++Sample)
+		{
+			FProcess Process;
+			SetFastProfileEnvironment(Process);
+			const double StartTime = FPlatformTime::Seconds();
+			if (Process.Launch(MercurialExecutablePath, Arguments))
+			{
+				Process.Wait();
+				BestTime = FMath::Min(BestTime, FPlatformTime::Seconds() - StartTime);
+			}
+		}
+		return BestTime;
+	};
+
+	auto GetDisableOptions = [&EnabledExtensions](const FString& InExceptExtension)
+	{
+		FString Options;
+		for (const FString& Extension : EnabledExtensions)
+		{
+			if (Extension != InExceptExtension)
+			{
+				Options += FString::Printf(TEXT("--config extensions.%s=! "), *Extension);
+			}
+		}
+		return Options;
+	};
+
+	OutBaseline = TimeCommand(GetDisableOptions(FString()));
+	for (const FString& Extension : EnabledExtensions)
+	{
+		OutCosts.Emplace(Extension, TimeCommand(GetDisableOptions(Extension)) - OutBaseline);
+	}
+	OutCosts.Sort([](const TPair<FString, double>& A, const TPair<FString, double>& B)
+	{
+		return A.Value > B.Value;
+	});
+}
+
+bool FClient::GetEnabledExtensions(
+	const FString& InRepositoryRoot, TArray<FString>& OutExtensions, 
+	TArray<FString>& OutErrors
+) const
+{
+	FString Output;
+	const FString Command = FString::Printf(
+		TEXT("config extensions -y --cwd %s"), *QuoteFilename(InRepositoryRoot)
+	);
+	if (!RunCommand(Command, Output, OutErrors))
+	{
+		// hg config fails when nothing matches, i.e. when there are no extensions
+		return OutErrors.Num() == 0;
+	}
+
+	// each line looks like extensions.name=path, extensions that are already disabled have 
+	// a path that starts with a '!'
+	const FString Prefix(TEXT("extensions."));
+	TArray<FString> Lines;
+	Output.ParseIntoArrayLines(Lines);
+	for (const FString& Line : Lines)
+	{
+		FString Name;
+		FString Path;
+		if (Line.StartsWith(Prefix) && Line.Split(TEXT("="), &Name, &Path) && 
+			!Path.StartsWith(TEXT("!")))
+		{
+			OutExtensions.Add(Name.RightChop(Prefix.Len()));
+		}
+	}
+	return true;
+}
+
+bool FClient::IsChgHealthy(const FString& InChgPath) const
+{
+	// this starts the command server if it isn't running yet, which takes as long as 
+	// a regular hg invocation, after that the command should be almost instant
+	FProcess Process;
+	Process.SetEnvironmentVariable(TEXT("CHGHG"), MercurialExecutablePath);
+	if (!Process.Launch(InChgPath, GlobalOptions + TEXT("version -q")))
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	const float Timeout = TimeoutPolicy.ReadTimeout;
+	while (Process.Pump())
+	{
+		if ((Timeout > 0.0f) && ((FPlatformTime::Seconds() - StartTime) > Timeout))
+		{
+			Process.Terminate();
+			Process.Wait();
+			return false;
+		}
+	}
+	return (Process.GetReturnCode() == 0) && !IsChgFailure(Process) &&
+		FProcess::OutputToString(Process.GetStdout()).Contains(TEXT("Mercurial"));
+}
+
+bool FClient::IsChgFailure(const FProcess& InProcess)
+{
+	// chg prefixes its own errors (as opposed to those of the command server) with "chg: ", 
+	// and they happen before the command gets a chance to run and print anything
+	return (InProcess.GetReturnCode() != 0) && (InProcess.GetStdout().Num() == 0) &&
+		FProcess::OutputToString(InProcess.GetStderr()).StartsWith(TEXT("chg: "));
+}
+
+void FClient::FallBackFromChg(const TCHAR* InReason) const
+{
+	if (FPlatformAtomics::InterlockedExchange(&bChgFailed, 1) == 0)
+	{
+		UE_LOG(
+			LogSourceControl, Warning, TEXT("chg misbehaved (%s), hg will be run directly."), 
+			InReason
+		);
+	}
+}
+
+void FClient::SetFastProfileEnvironment(FProcess& InProcess)
+{
+	// ignore any user settings that change the output (aliases, defaults, verbosity, 
+	// localization), and don't make hg work out the encoding from the locale
+	InProcess.SetEnvironmentVariable(TEXT("HGPLAIN"), TEXT("1"));
+	InProcess.SetEnvironmentVariable(TEXT("HGENCODING"), TEXT("utf-8"));
+}
+
+bool FClient::IsReadOnlyCommand(const FString& InCommand)
+{
+	static const TCHAR* ReadOnlyCommands[] = { 
+		TEXT("status"), TEXT("log"), TEXT("cat"), TEXT("parents"), TEXT("files"), 
+		TEXT("version"), TEXT("config"), TEXT("root")
+	};
+	for (const TCHAR* ReadOnlyCommand : ReadOnlyCommands)
+	{
+		const int32 Length = FCString::Strlen(ReadOnlyCommand);
+		if (InCommand.StartsWith(ReadOnlyCommand, ESearchCase::CaseSensitive) && 
+			((InCommand.Len() == Length) || (InCommand[Length] == TEXT(' '))))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FClient::IsMemoizableCommand(const FString& InCommand)
+{
+	// cat is read-only, but it writes its output to files, so it can't be memoized
+	return (InCommand == TEXT("status")) || (InCommand == TEXT("log"));
+}
+
+FRepositoryFingerprint FClient::GetFingerprint(
+	const FString& InCommand, const FString& InWorkingDirectory, const TArray<FString>& InFiles
+)
+{
+	FString RepositoryRoot;
+	if (!GetRepositoryRoot(InWorkingDirectory, RepositoryRoot))
+	{
+		RepositoryRoot = InWorkingDirectory;
+	}
+	FRepositoryFingerprint Fingerprint = FRepositoryFingerprint::FromRepository(RepositoryRoot);
+	// the history of a file only changes when a revision is added, but its status changes
+	// whenever it's modified
+	if (InCommand == TEXT("status"))
+	{
+		Fingerprint.AddWorkingFiles(InWorkingDirectory, InFiles);
+	}
+	return Fingerprint;
+}
+
 int32 FClient::GetFullCommandLength(const FString& InCommand, const TArray<FString>& InFiles)
 {
 	int32 Length = InCommand.Len();
@@ -512,22 +1187,172 @@ bool FClient::RunCommand(
 	const FString& InCommand, FString& OutResults, TArray<FString>& OutErrorMessages
 ) const
 {
-	UE_LOG(LogSourceControl, Log, TEXT("Executing hg %s"), *InCommand);
-
-	int32 ReturnCode = 0;
-	FString StdError;
-
-	FPlatformProcess::ExecProcess(
-		*MercurialExecutablePath, *InCommand, &ReturnCode, &OutResults, &StdError
-	);
+	FProcess Process;
+	return RunCommand(Process, InCommand, OutResults, OutErrorMessages);
+}
 
-	TArray<FString> ErrorMessages;
-	if (StdError.ParseIntoArray(ErrorMessages, TEXT("\n"), true) > 0)
+bool FClient::RunCommand(
+	FProcess& InProcess, const FString& InCommand, FString& OutResults, 
+	TArray<FString>& OutErrorMessages
+) const
+{
+	// The command that's executing on this thread (if any) may be cancelled at any time, but 
+	// only a read-only hg command may be stopped (or skipped) because of it. The worker may be 
+	// part way through a series of modifications that must not be left half-applied.
+	const bool bIsReadOnly = IsReadOnlyCommand(InCommand);
+	const FCommand* Command = FCommand::GetCurrent();
+	auto IsCancelled = [Command, bIsReadOnly]() 
+	{ 
+		return bIsReadOnly && Command && Command->IsCancelRequested(); 
+	};
+
+	const FString Arguments = bIsReadOnly ? 
+		(GlobalOptions + FastProfileOptions + InCommand) : (GlobalOptions + InCommand);
+	if (bFastProfile)
+	{
+		SetFastProfileEnvironment(InProcess);
+	}
+	const float Timeout = bIsReadOnly ? TimeoutPolicy.ReadTimeout : TimeoutPolicy.WriteTimeout;
+	if (!bIsReadOnly)
 	{
-		OutErrorMessages.Append(ErrorMessages);
+		// anything memoized while this command runs will have a fingerprint that's taken 
+		// before the repository is modified, so it won't be reused afterwards
+		Memo.Empty();
 	}
 
-	return ReturnCode == 0;
+	int32 Attempt = 0;
+	while (!IsCancelled())
+	{
+		UE_LOG(LogSourceControl, Log, TEXT("Executing hg %s"), *InCommand);
+
+		// chg hands its stdio over to the command server, but not any other descriptors, so the 
+		// server would open its own (unrelated) descriptors when hg reads from an input stream
+		const bool bUseChg = IsUsingChg() && !InProcess.HasInputStreams();
+		if (bUseChg)
+		{
+			InProcess.SetEnvironmentVariable(TEXT("CHGHG"), MercurialExecutablePath);
+		}
+		const FString& Executable = bUseChg ? ChgExecutablePath : MercurialExecutablePath;
+
+		if (!InProcess.Launch(Executable, Arguments))
+		{
+			if (bUseChg)
+			{
+				FallBackFromChg(TEXT("couldn't be launched"));
+				continue;
+			}
+			OutErrorMessages.Add(FString::Printf(TEXT("Failed to launch '%s'"), *Executable));
+			return false;
+		}
+
+		// watch over hg while it runs
+		const double StartTime = FPlatformTime::Seconds();
+		int32 StderrSize = 0;
+		FString LockMessage;
+		bool bCancelled = false;
+		bool bTimedOut = false;
+		// time at which hg was asked to stop, zero while it's allowed to run
+		double StopTime = 0.0;
+		// set once hg failed to stop within the grace period
+		bool bStopEscalated = false;
+		while (InProcess.Pump())
+		{
+			const double Now = FPlatformTime::Seconds();
+			if (StopTime == 0.0)
+			{
+				bCancelled = IsCancelled();
+				bTimedOut = !bCancelled && (Timeout > 0.0f) && ((Now - StartTime) > Timeout);
+				if (bCancelled || bTimedOut)
+				{
+					UE_LOG(
+						LogSourceControl, Log, TEXT("Stopping %s hg %s"), 
+						bCancelled ? TEXT("cancelled") : TEXT("timed out"), *InCommand
+					);
+					// Killing hg outright could leave an abandoned transaction and a stale lock 
+					// behind, and under chg it would only kill the client anyway, so let it 
+					// clean up first.
+					StopTime = InProcess.Interrupt() ? Now : (Now - StopGracePeriod);
+				}
+			}
+			else if (!bStopEscalated && ((Now - StopTime) >= StopGracePeriod))
+			{
+				bStopEscalated = true;
+				if (bIsReadOnly)
+				{
+					InProcess.Terminate();
+				}
+				else
+				{
+					// killing hg while it's modifying the repository would leave the working 
+					// copy in a worse state than waiting for it, so just report the hang
+					UE_LOG(
+						LogSourceControl, Error, 
+						TEXT("hg %s isn't responding, it won't be killed because it may be ")
+						TEXT("modifying the repository. %s"), 
+						*InCommand, *LockMessage
+					);
+				}
+			}
+
+			if (LockMessage.IsEmpty() && (InProcess.GetStderr().Num() != StderrSize))
+			{
+				StderrSize = InProcess.GetStderr().Num();
+				if (FindLockMessage(FProcess::OutputToString(InProcess.GetStderr()), LockMessage))
+				{
+					UE_LOG(LogSourceControl, Warning, TEXT("%s"), *LockMessage);
+				}
+			}
+		}
+
+		if (bCancelled)
+		{
+			return false;
+		}
+
+		if (bUseChg && !bTimedOut && IsChgFailure(InProcess))
+		{
+			// the command didn't get as far as the command server, so it's safe to run it again
+			FallBackFromChg(*FProcess::OutputToString(InProcess.GetStderr()).TrimEnd());
+			continue;
+		}
+
+		const FString StdError = FProcess::OutputToString(InProcess.GetStderr());
+		// a command that modifies the repository may still succeed if it couldn't be stopped
+		const bool bSucceeded = (!bTimedOut || !bIsReadOnly) && (InProcess.GetReturnCode() == 0);
+		const bool bLocked = !bSucceeded && !bTimedOut && FindLockMessage(StdError, LockMessage);
+
+		if (bLocked && (Attempt < TimeoutPolicy.LockRetries))
+		{
+			// back off for a while, in case the lock is held by something that'll finish soon
+			const double RetryTime = FPlatformTime::Seconds() + 
+				TimeoutPolicy.LockRetryDelay * (float)(1 << FMath::Min(Attempt, 16));
+			UE_LOG(
+				LogSourceControl, Warning, TEXT("Repository is locked, hg %s will be retried"), 
+				*InCommand
+			);
+			while (!IsCancelled() && (FPlatformTime::Seconds() < RetryTime))
+			{
+				FPlatformProcess::Sleep(0.05f);
+			}
+			++Attempt;
+			continue;
+		}
+
+		OutResults = FProcess::OutputToString(InProcess.GetStdout());
+		TArray<FString> ErrorMessages;
+		if (StdError.ParseIntoArray(ErrorMessages, TEXT("\n"), true) > 0)
+		{
+			OutErrorMessages.Append(ErrorMessages);
+		}
+		if (bTimedOut && !bSucceeded)
+		{
+			OutErrorMessages.Add(FString::Printf(
+				TEXT("hg %s timed out after %.0f seconds"), *InCommand, Timeout
+			));
+		}
+		return bSucceeded;
+	}
+	return false;
 }
 
 bool FClient::RunCommand(
@@ -535,19 +1360,44 @@ bool FClient::RunCommand(
 	const FString& InWorkingDirectory, const TArray<FString>& InFiles, bool bForceFileList,
 	FString& OutResults, TArray<FString>& OutErrorMessages
 ) const
+{
+	FProcess Process;
+	return RunCommand(
+		Process, InCommand, InOptions, InWorkingDirectory, InFiles, bForceFileList, 
+		OutResults, OutErrorMessages
+	);
+}
+
+bool FClient::RunCommand(
+	FProcess& InProcess, const FString& InCommand, const TArray<FString>& InOptions,
+	const FString& InWorkingDirectory, const TArray<FString>& InFiles, bool bForceFileList,
+	FString& OutResults, TArray<FString>& OutErrorMessages
+) const
 {
 	FString Command(InCommand);
 	AppendCommandOptions(Command, InOptions, InWorkingDirectory);
 
-	// on Windows 7+ this number is actually around 32,000, but we'll pick something lower in case
-	// other platforms are less generous
-	const int32 MaxCommandLineLength = 16000;
+	// the fingerprint must be taken before hg runs, so that any changes hg doesn't see 
+	// invalidate the memoized output
+	FString MemoKey;
+	FRepositoryFingerprint Fingerprint;
+	if (IsMemoizableCommand(InCommand))
+	{
+		MemoKey = Command + TEXT("\n") + FString::Join(InFiles, TEXT("\n"));
+		Fingerprint = GetFingerprint(InCommand, InWorkingDirectory, InFiles);
+		if (Memo.Find(MemoKey, Fingerprint, OutResults))
+		{
+			UE_LOG(LogSourceControl, Verbose, TEXT("Reusing output of hg %s"), *Command);
+			return true;
+		}
+	}
 
 	if (bForceFileList
 		|| ((InFiles.Num() > 0) && (GetFullCommandLength(Command, InFiles) > MaxCommandLineLength)))
 	{
-		// Write all the filenames to be committed to a temp file that will be passed in to hg,
-		// this gets around command-line argument length limitations.
+		// Pipe all the filenames to hg through a list file stream instead of passing them on the
+		// command line, this gets around command-line argument length limitations without 
+		// writing a temp file.
 		FString FileList;
 		for (const auto& RelativeFilename : InFiles)
 		{
@@ -555,32 +1405,75 @@ bool FClient::RunCommand(
 			FileList += RelativeFilename + TEXT("\n");
 		}
 
-		// The file list must be saved using the system's default encoding, because that's the
-		// encoding hg will always use when reading in the file list. For future reference:
-		// http://mercurial.selenic.com/wiki/EncodingStrategy
-		// http://en.it-usenet.org/thread/16853/40385/
-		FScopedTempFile ListFile(TEXT(".lst"));
-		bool bResult = FFileHelper::SaveStringToFile(
-			FileList, *ListFile.GetFilename(), FFileHelper::EEncodingOptions::ForceAnsi
+		const FString ListFile = InProcess.AddInputStream(EncodeFileList(FileList));
+		AppendCommandFile(Command, FString::Printf(TEXT("listfile:%s"), *ListFile));
+	}
+	else
+	{
+		AppendCommandFiles(Command, InFiles);
+	}
+
+	const bool bResult = RunCommand(InProcess, Command, OutResults, OutErrorMessages);
+	if (bResult && !MemoKey.IsEmpty())
+	{
+		Memo.Add(MemoKey, Fingerprint, OutResults);
+	}
+	return bResult;
+}
+
+bool FClient::RunChunkedCommand(
+	const FString& InCommand, const TArray<FString>& InOptions,
+	const FString& InWorkingDirectory, const TArray<FString>& InFiles,
+	TArray<FString>& OutResults, TArray<FString>& OutErrorMessages
+) const
+{
+	const int32 NumChunks = FMath::Clamp(
+		InFiles.Num() / MinFilesPerChunk, 1, 
+		FMath::Min(MaxParallelProcesses, FPlatformMisc::NumberOfCores())
+	);
+	if (NumChunks == 1)
+	{
+		OutResults.SetNum(1);
+		return RunCommand(
+			InCommand, InOptions, InWorkingDirectory, InFiles, false, OutResults[0], 
+			OutErrorMessages
 		);
+	}
 
-		if (!bResult)
+	const int32 FilesPerChunk = FMath::DivideAndRoundUp(InFiles.Num(), NumChunks);
+	TArray<TArray<FString>> ErrorsPerChunk;
+	TArray<bool> ResultPerChunk;
+	OutResults.SetNum(NumChunks);
+	ErrorsPerChunk.SetNum(NumChunks);
+	ResultPerChunk.SetNumZeroed(NumChunks);
+
+	FCommand* Command = FCommand::GetCurrent();
+	ParallelFor(NumChunks,
+		[&](int32 Index)
 		{
-			OutErrorMessages.Add(
-				FString::Printf(TEXT("Failed to write to temp file: '%s'"), *ListFile.GetFilename())
+			FCommand::FScopedCurrent ScopedCommand(Command);
+			const int32 FirstFile = Index * FilesPerChunk;
+			const int32 NumFiles = FMath::Min(FilesPerChunk, InFiles.Num() - FirstFile);
+			if (NumFiles <= 0)
+			{
+				ResultPerChunk[Index] = true;
+				return;
+			}
+			TArray<FString> ChunkFiles(InFiles.GetData() + FirstFile, NumFiles);
+			ResultPerChunk[Index] = RunCommand(
+				InCommand, InOptions, InWorkingDirectory, ChunkFiles, false, 
+				OutResults[Index], ErrorsPerChunk[Index]
 			);
-			return false;
 		}
+	);
 
-		AppendCommandFile(Command, FString::Printf(TEXT("listfile:%s"), *ListFile.GetFilename()));
-		// ListFile must be in-scope when this call is made
-		return RunCommand(Command, OutResults, OutErrorMessages);
-	}
-	else
+	bool bResult = true;
+	for (int32 i = 0; i < NumChunks; ++i)
 	{
-		AppendCommandFiles(Command, InFiles);
-		return RunCommand(Command, OutResults, OutErrorMessages);
+		OutErrorMessages.Append(ErrorsPerChunk[i]);
+		bResult &= ResultPerChunk[i];
 	}
+	return bResult;
 }
 
 bool FClient::RunCommand(
@@ -589,10 +1482,13 @@ bool FClient::RunCommand(
 	FString& OutResults, TArray<FString>& OutErrorMessages
 ) const
 {
-	FString Command(InCommand);
-	AppendCommandOptions(Command, InOptions, InWorkingDirectory);
-	AppendCommandFile(Command, InFilename);
-	return RunCommand(Command, OutResults, OutErrorMessages);
+	TArray<FString> Files;
+	Files.Add(InFilename);
+	FProcess Process;
+	return RunCommand(
+		Process, InCommand, InOptions, InWorkingDirectory, Files, false, OutResults, 
+		OutErrorMessages
+	);
 }
 
 FString FClient::QuoteFilename(const FString& InFilename)
@@ -791,19 +1687,7 @@ bool FClient::ConvertFilesToRelative(
 	const FString& InRelativeTo, const TArray<FString>& InFiles, TArray<FString>& OutFiles
 )
 {
-	for (const auto& AbsoluteFilename : InFiles)
-	{
-		FString Filename = AbsoluteFilename;
-		if (FPaths::MakePathRelativeTo(Filename, *InRelativeTo))
-		{
-			OutFiles.Add(Filename);
-		}
-		else
-		{
-			return false;
-		}
-	}
-	return true;
+	return FPathNormalizer::ToRelative(InRelativeTo, InFiles, OutFiles);
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -25,6 +25,9 @@
 
 #include "MercurialSourceControlFileState.h"
 #include "MercurialSourceControlFileRevision.h"
+#include "MercurialSourceControlProviderSettings.h"
+#include "MercurialSourceControlCommandMemo.h"
+#include "MercurialSourceControlIgnoreMatcher.h"
 
 class FXmlFile;
 
@@ -33,6 +36,18 @@ namespace MercurialSourceControl {
 typedef TSharedPtr<class FClient, ESPMode::ThreadSafe> FClientSharedPtr;
 
 class FFileState;
+class FProcess;
+
+/** Outcome of removing a single file with FClient::RemoveAllFiles(). */
+struct FRemoveFileResult
+{
+	/** Absolute filename of the file. */
+	FString Filename;
+	/** Status the file had before it was removed. */
+	EFileStatus OldStatus;
+	/** True if the file was removed from the repository and deleted from disk. */
+	bool bRemoved;
+};
 
 /** Executes source control commands in a Mercurial repository by invoking hg.exe.  */
 class FClient : public TSharedFromThis<FClient, ESPMode::ThreadSafe>
@@ -44,23 +59,48 @@ public:
 	 */
 	static bool IsValidExecutable(const FString& InFilename);
 
+	/** Locate a valid Mercurial executable in one of the usual install locations. */
 	static bool FindExecutable(FString& OutFilename);
 
+	/** 
+	 * Locate a Mercurial executable in one of the usual install locations, without checking 
+	 * that it's valid.
+	 */
+	static bool LocateExecutable(FString& OutFilename);
+
+	/** 
+	 * Locate chg, the C client that runs commands in a forked Mercurial command server, 
+	 * for the given Mercurial executable. chg is looked for next to hg, and then on the PATH.
+	 * @note chg isn't available on Windows.
+	 */
+	static bool LocateChg(const FString& InMercurialPath, FString& OutChgPath);
+
 	/**
-	 * Create and initialize the FClient singleton instance.
+	 * Create the FClient singleton instance.
 	 * @param InMercurialPath Absolute path to the Mercurial executable that should be invoked to
 	 *                        manipulate a Mercurial repository.
-	 * @param OutError Will contain an error message if this method returns false.
-	 * @return true if the singleton instance was created and initialized successfully, 
-	 *         false otherwise.
+	 * @param InTimeoutPolicy Limits on how long hg may run for.
+	 * @param bInPreferChg If true and chg can be found and passes a health check commands will 
+	 *                     be run through chg, which will in turn run InMercurialPath.
+	 * @param bInFastProfile If true hg will be run with the fast profile, see EnableFastProfile().
+	 * @param InRepositoryRoot Root of the repository the client will be used with, must end in 
+	 *                         a '/'. Only used by the fast profile.
+	 * @note The executable isn't validated here, that's up to the caller, see IsValidExecutable().
 	 */
-	static bool Create(const FString& InMercurialPath, FText& OutError);
+	static void Create(
+		const FString& InMercurialPath, const FTimeoutPolicy& InTimeoutPolicy, bool bInPreferChg,
+		bool bInFastProfile, const FString& InRepositoryRoot
+	);
 	static const FClientSharedPtr& Get();
 	static void Destroy();
 
+	/** 
+	 * Get the root directory of the repository in which the given working directory resides.
+	 * This doesn't invoke hg, it just looks for the .hg directory.
+	 */
+	static bool GetRepositoryRoot(const FString& InWorkingDirectory, FString& OutRepositoryRoot);
+
 public:
-	/** Get the root directory of the repository in which the given working directory resides. */
-	bool GetRepositoryRoot(const FString& InWorkingDirectory, FString& OutRepositoryRoot) const;
 
 	bool GetFileStates(
 		const FString& InWorkingDirectory, const TArray<FString>& InAbsoluteFiles,
@@ -114,16 +154,20 @@ public:
 		TArray<FString>& OutErrors
 	) const;
 
-	/** Remove clean and missing files from the repository. */
-	bool RemoveFiles(
-		const FString& InWorkingDirectory, const TArray<FString>& InAbsoluteFiles, 
-		TArray<FString>& OutErrors
-	) const;
-
-	/** Remove added, clean, and missing files from the repository. */
+	/** 
+	 * Remove added, clean, and missing files from the repository, and delete them from disk.
+	 * Files with any other status are left alone.
+	 * @param InWorkingDirectory The working directory to set for hg.exe.
+	 * @param InFileStates The current states of the files to remove (e.g. from the file state 
+	 *                     cache), hg will be asked for the status of any files whose status 
+	 *                     is unknown.
+	 * @param OutResults Will be filled in with the outcome for each file hg knows about.
+	 * @param OutErrors Output from stderr of hg.exe.
+	 * @return true if all the removable files were removed, false otherwise.
+	 */
 	bool RemoveAllFiles(
-		const FString& InWorkingDirectory, const TArray<FString>& InAbsoluteFiles,
-		TArray<FString>& OutErrors
+		const FString& InWorkingDirectory, const TArray<FFileState>& InFileStates,
+		TArray<FRemoveFileResult>& OutResults, TArray<FString>& OutErrors
 	) const;
 
 	bool CommitFiles(
@@ -131,7 +175,41 @@ public:
 		const FString& InCommitMessage, TArray<FString>& OutErrors
 	) const;
 
-	/** Get the local ID of the working directory's parent revision. */
+	/** 
+	 * Measure how much each of the enabled extensions adds to the startup time of hg.
+	 * @param InRepositoryRoot Root of the repository, must end in a '/'.
+	 * @param InNumSamples Number of times to time each configuration, the best time is used.
+	 * @param OutBaseline Seconds a trivial command takes with all extensions disabled.
+	 * @param OutCosts Extra seconds each extension adds to the baseline, most expensive first.
+	 */
+	void MeasureExtensionCosts(
+		const FString& InRepositoryRoot, int32 InNumSamples, double& OutBaseline,
+		TArray<TPair<FString, double> >& OutCosts
+	) const;
+
+	/** 
+	 * Check if commands are being run through chg, this may change at any time because 
+	 * the client falls back to running hg directly if chg misbehaves.
+	 */
+	bool IsUsingChg() const
+	{
+		return !ChgExecutablePath.IsEmpty() && (bChgFailed == 0);
+	}
+
+	/** 
+	 * Get the filenames of all the files tracked in the working directory.
+	 * The dirstate is read directly if possible, hg is only invoked if that fails.
+	 * @param InRepositoryRoot Root of the repository, must end in a '/'.
+	 * @param OutFiles Will be filled in with filenames relative to the repository root.
+	 */
+	bool GetTrackedFiles(
+		const FString& InRepositoryRoot, TArray<FString>& OutFiles, TArray<FString>& OutErrors
+	) const;
+
+	/** 
+	 * Get the local ID of the working directory's parent revision.
+	 * The dirstate and changelog are read directly if possible, hg is only invoked if that fails.
+	 */
 	bool GetWorkingDirectoryParentRevisionID(
 		const FString& InWorkingDirectory, FString& OutRevisionID, TArray<FString>& OutErrors
 	) const;
@@ -145,6 +223,88 @@ private:
 	static void AppendCommandFiles(FString& InOutCommand, const TArray<FString>& InFiles);
 	static int32 GetFullCommandLength(const FString& InCommand, const TArray<FString>& InFiles);
 
+	/** 
+	 * Get the maximum length of the command line (excluding the executable) that the given 
+	 * executable can be launched with on this platform.
+	 */
+	static int32 GetMaxCommandLineLength(const FString& InExecutable);
+
+	/** 
+	 * Check that chg can start a command server and run a trivial command through it.
+	 * @return true if chg is usable, false otherwise.
+	 */
+	bool IsChgHealthy(const FString& InChgPath) const;
+
+	/** 
+	 * Check if a command run through chg failed because of chg itself (e.g. it couldn't 
+	 * connect to or start the command server), rather than because of the command.
+	 */
+	static bool IsChgFailure(const FProcess& InProcess);
+
+	/** Stop running commands through chg, hg will be run directly from now on. */
+	void FallBackFromChg(const TCHAR* InReason) const;
+
+	/** 
+	 * Switch to the fast profile, in which hg is run with HGPLAIN set, with a pinned encoding, 
+	 * and (for read-only commands) with all the extensions that don't affect the plugin's 
+	 * commands disabled. Commands that modify the repository keep all the user's extensions, 
+	 * some of them may enforce policies (e.g. pre-commit checks).
+	 * @param InRepositoryRoot Root of the repository, must end in a '/'. The repository's own 
+	 *                         config and requirements are taken into account.
+	 * @note Only called by Create(), before the client is made available to other threads.
+	 */
+	void EnableFastProfile(const FString& InRepositoryRoot);
+
+	/** Set the environment variables that are part of the fast profile. */
+	static void SetFastProfileEnvironment(FProcess& InProcess);
+
+	/** 
+	 * Get the matcher for the ignore rules of the given repository, compiling it if necessary.
+	 * @return nullptr if the matcher can't be used, in which case hg should be asked which 
+	 *         files are ignored.
+	 */
+	FIgnoreMatcherPtr GetIgnoreMatcher(const FString& InWorkingDirectory) const;
+
+	/** Get the files listed in the ui.ignore settings of the given repository. */
+	bool GetIgnoreFiles(
+		const FString& InRepositoryRoot, TArray<FString>& OutIgnoreFiles, 
+		TArray<FString>& OutErrors
+	) const;
+
+	/** 
+	 * Work out the states of the untracked files among the given files and within the given 
+	 * directories, without invoking hg. Ignored directories are only walked if they were 
+	 * asked for explicitly.
+	 * @param InRelativeFiles Files and directories relative to the repository root.
+	 * @param InTrackedFiles Files hg reported a status for, relative to the repository root.
+	 */
+	static void GetUntrackedFileStates(
+		const FString& InRepositoryRoot, const TArray<FString>& InRelativeFiles, 
+		const FIgnoreMatcher& InIgnoreMatcher, const TSet<FString>& InTrackedFiles,
+		TArray<FFileState>& OutFileStates
+	);
+
+	/** Get the names of all the extensions enabled in the given repository. */
+	bool GetEnabledExtensions(
+		const FString& InRepositoryRoot, TArray<FString>& OutExtensions, 
+		TArray<FString>& OutErrors
+	) const;
+
+	/** Check if the given fully formed hg command leaves the repository unchanged. */
+	static bool IsReadOnlyCommand(const FString& InCommand);
+
+	/** Check if the output of the given hg command (e.g. status) can be memoized. */
+	static bool IsMemoizableCommand(const FString& InCommand);
+
+	/** 
+	 * Fingerprint the repository the given working directory is in, for the purpose of 
+	 * memoizing the output of the given hg command.
+	 */
+	static FRepositoryFingerprint GetFingerprint(
+		const FString& InCommand, const FString& InWorkingDirectory, 
+		const TArray<FString>& InFiles
+	);
+
 	/** Enclose the given filename in double-quotes. */
 	static FString QuoteFilename(const FString& InFilename);
 
@@ -175,8 +335,9 @@ private:
 	/**
 	 * Constructor. 
 	 * @param InMercurialPath Absolute valid path to hg.exe.
+	 * @param InTimeoutPolicy Limits on how long hg.exe may run for.
 	 */
-	FClient(const FString& InMercurialPath) : MercurialExecutablePath(InMercurialPath) {}
+	FClient(const FString& InMercurialPath, const FTimeoutPolicy& InTimeoutPolicy);
 
 	/**
 	 * Invoke hg.exe with the given command and return the output.
@@ -189,6 +350,21 @@ private:
 		const FString& InCommand, FString& OutResults, TArray<FString>& OutErrorMessages
 	) const;
 
+	/**
+	 * Invoke hg.exe with the given command in the given process and return the output.
+	 * @param InProcess A process that hasn't been launched yet, any input for hg.exe should 
+	 *                  already be set up.
+	 * @note If the command executing on the calling thread is cancelled, or hg.exe exceeds its 
+	 *       timeout, a read-only hg.exe will be terminated and false will be returned, hg 
+	 *       commands that modify the repository ignore cancellation and are left to finish.
+	 *       Commands that fail because the repository is locked are retried as per the timeout 
+	 *       policy.
+	 */
+	bool RunCommand(
+		FProcess& InProcess, const FString& InCommand, FString& OutResults, 
+		TArray<FString>& OutErrorMessages
+	) const;
+
 	/**
 	 * Invoke hg.exe with the given arguments and return the output.
 	 * @param InCommand An hg command, e.g. add
@@ -196,10 +372,12 @@ private:
 	 * @param InWorkingDirectory The working directory to set for hg.exe.
 	 * @param InFiles Zero or more filenames the hg command should operate on, all filenames should
 	 *                be relative to InWorkingDirectory.
-	 * @param bForceFileList If true force all filenames in InFiles to be written to a temporary
-	 *                       file which is then passed in as a command argument instead of the
-	 *                       individual filenames in InFiles.
-	 *                       If false a temporary file will only be used when command line length 
+	 * @note The output of some read-only commands (e.g. status) is memoized, in which case hg
+	 *       will only be invoked if the repository has changed since the last time the same 
+	 *       command was run.
+	 * @param bForceFileList If true force all filenames in InFiles to be piped to hg.exe as a 
+	 *                       list file instead of being passed in as individual command arguments.
+	 *                       If false a list file will only be used when command line length 
 	 *                       limits are exceeded.
 	 * @param OutResults Output from stdout of hg.exe.
 	 * @param OutErrorMessages Output from stderr of hg.exe.
@@ -211,6 +389,17 @@ private:
 		FString& OutResults, TArray<FString>& OutErrorMessages
 	) const;
 
+	/**
+	 * Invoke hg.exe with the given arguments in the given process and return the output.
+	 * @param InProcess A process that hasn't been launched yet, any input for hg.exe should 
+	 *                  already be set up.
+	 */
+	bool RunCommand(
+		FProcess& InProcess, const FString& InCommand, const TArray<FString>& InOptions, 
+		const FString& InWorkingDirectory, const TArray<FString>& InFiles, bool bForceFileList,
+		FString& OutResults, TArray<FString>& OutErrorMessages
+	) const;
+
 	/**
 	 * Invoke hg.exe with the given arguments and return the output.
 	 * @param InCommand An hg command, e.g. add
@@ -228,8 +417,49 @@ private:
 		FString& OutResults, TArray<FString>& OutErrorMessages
 	) const;
 
+	/**
+	 * Invoke hg.exe with the given arguments and return the output. If there are a lot of files
+	 * they'll be split into chunks which will be processed in parallel by separate hg.exe 
+	 * processes, so this should only be used for read-only commands.
+	 * @param OutResults Output from stdout of hg.exe for each chunk, the chunks are in the same 
+	 *                   order as the files in InFiles.
+	 * @param OutErrorMessages Output from stderr of hg.exe for each chunk, in the same order.
+	 * @return true if hg indicated the command was successful for all chunks, false otherwise.
+	 */
+	bool RunChunkedCommand(
+		const FString& InCommand, const TArray<FString>& InOptions,
+		const FString& InWorkingDirectory, const TArray<FString>& InFiles,
+		TArray<FString>& OutResults, TArray<FString>& OutErrorMessages
+	) const;
+
 private:
 	FString MercurialExecutablePath;
+	/** Command lines longer than this will have their files passed in via a list file. */
+	int32 MaxCommandLineLength;
+
+	FTimeoutPolicy TimeoutPolicy;
+
+	/** Options that precede every command, each one is followed by a space. */
+	FString GlobalOptions;
+
+	/** Is hg being run with the fast profile? */
+	bool bFastProfile;
+
+	/** Options that disable extensions for read-only commands run with the fast profile. */
+	FString FastProfileOptions;
+
+	/** Path to chg, empty if hg is run directly. */
+	FString ChgExecutablePath;
+
+	/** Set when chg misbehaves, after which hg is run directly. */
+	mutable volatile int32 bChgFailed;
+
+	/** Output of recent read-only commands, emptied whenever the repository is modified. */
+	mutable FCommandMemo Memo;
+
+	/** Compiled lazily, and recompiled whenever the ignore rules change. */
+	mutable FIgnoreMatcherPtr IgnoreMatcher;
+	mutable FCriticalSection IgnoreMatcherCriticalSection;
 
 private:
 	static FClientSharedPtr Singleton;
@@ -24,12 +24,16 @@
 
 #include "MercurialSourceControlPrivatePCH.h"
 #include "MercurialSourceControlCommand.h"
+#include "MercurialSourceControlScheduler.h"
 
 namespace MercurialSourceControl {
 
+thread_local FCommand* FCommand::CurrentCommand = nullptr;
+
 FCommand::FCommand(
 	const FString& InWorkingDirectory,
 	const FString& InContentDirectory,
+	FFileStateCache& InFileStateCache,
 	const FSourceControlOperationRef& InOperation, 
 	const FWorkerRef& InWorker, 
 	const FSourceControlOperationComplete& InCompleteDelegate
@@ -37,21 +41,48 @@ FCommand::FCommand(
 	, Worker(InWorker)
 	, WorkingDirectory(InWorkingDirectory)
 	, ContentDirectory(InContentDirectory)
+	, FileStateCache(InFileStateCache)
 	, OperationCompleteDelegate(InCompleteDelegate)
+	, StartState(NotStarted)
 	, bExecuteProcessed(0)
+	, bCancelRequested(0)
+	, CompletionEvent(FPlatformProcess::GetSynchEventFromPool(true))
 	, bCommandSuccessful(false)
 	, Concurrency(EConcurrency::Synchronous)
+	, Scheduler(nullptr)
 {
 	check(IsInGameThread());
 }
 
+FCommand::~FCommand()
+{
+	FPlatformProcess::ReturnSynchEventToPool(CompletionEvent);
+	CompletionEvent = nullptr;
+}
+
 bool FCommand::DoWork()
 {
-	bCommandSuccessful = Worker->Execute(*this);
-	FPlatformAtomics::InterlockedExchange(&bExecuteProcessed, 1);
+	FScopedCurrent ScopedCurrent(this);
+	const bool bClaimed = 
+		FPlatformAtomics::InterlockedCompareExchange(&StartState, Started, NotStarted) == NotStarted;
+	bCommandSuccessful = bClaimed && !IsCancelRequested() && Worker->Execute(*this);
+	MarkExecuted();
 	return bCommandSuccessful;
 }
 
+bool FCommand::CancelBeforeStart()
+{
+	const int32 OldState = FPlatformAtomics::InterlockedCompareExchange(
+		&StartState, CancelledBeforeStart, NotStarted
+	);
+	if (OldState == Started)
+	{
+		return false;
+	}
+	Cancel();
+	return true;
+}
+
 void FCommand::DoThreadedWork()
 {
 	Concurrency = EConcurrency::Asynchronous;
@@ -60,6 +91,18 @@ void FCommand::DoThreadedWork()
 
 void FCommand::Abandon()
 {
+	MarkExecuted();
+}
+
+void FCommand::MarkExecuted()
+{
+	// the scheduler must be notified and the event triggered before the command is flagged as 
+	// executed, because the main thread is free to delete the command as soon as it sees the flag
+	if (Scheduler)
+	{
+		Scheduler->OnCommandFinished(this);
+	}
+	CompletionEvent->Trigger();
 	FPlatformAtomics::InterlockedExchange(&bExecuteProcessed, 1);
 }
 
@@ -28,6 +28,9 @@
 
 namespace MercurialSourceControl {
 
+class FCommandScheduler;
+class FFileStateCache;
+
 typedef TSharedRef<class ISourceControlOperation, ESPMode::ThreadSafe> FSourceControlOperationRef;
 
 /**
@@ -40,36 +43,113 @@ public:
 	FCommand(
 		const FString& InWorkingDirectory,
 		const FString& InContentDirectory,
+		FFileStateCache& InFileStateCache,
 		const FSourceControlOperationRef& InOperation,
 		const FWorkerRef& InWorker, 
 		const FSourceControlOperationComplete& InCompleteDelegate = FSourceControlOperationComplete()
 	);
 
+	virtual ~FCommand();
+
 	/** Execute the command. */
 	bool DoWork();
 	
+	/** Return true iff the command has started executing. */
+	bool HasStarted() const
+	{
+		return StartState == Started;
+	}
+
 	/** Return true iff the command has finished executing. */
 	bool HasExecuted() const
 	{
 		return bExecuteProcessed != 0;
 	}
 
-	/** Update the state of any affected items after the command has executed. */
-	bool UpdateStates()
+	/** 
+	 * Block the calling thread until the command finishes executing, or the timeout expires.
+	 * @return true if the command finished executing, false if the wait timed out.
+	 */
+	bool WaitForCompletion(uint32 InTimeoutMs)
+	{
+		return CompletionEvent->Wait(InTimeoutMs);
+	}
+
+	/** 
+	 * Update the state of any affected items after the command has executed.
+	 * @param OutChangedFiles The IDs of any files whose state was changed by the command will be
+	 *                        appended to this.
+	 */
+	bool UpdateStates(TArray<FPathId>& OutChangedFiles)
 	{
 		check(bExecuteProcessed);
 
-		return Worker->UpdateStates();
+		return Worker->UpdateStates(OutChangedFiles);
 	}
 
-	/** Get the result (succeeded/failed) of the command execution. */
+	/** Get the result (succeeded/failed/cancelled) of the command execution. */
 	ECommandResult::Type GetResult() const
 	{
 		check(bExecuteProcessed);
 
-		return bCommandSuccessful ? ECommandResult::Succeeded : ECommandResult::Failed;
+		if (bCommandSuccessful)
+		{
+			return ECommandResult::Succeeded;
+		}
+		return IsCancelRequested() ? ECommandResult::Cancelled : ECommandResult::Failed;
 	}
 
+	/** 
+	 * Request that the command stop executing as soon as possible, any read-only hg process 
+	 * the command is waiting on will be stopped. Commands that modify the repository are only 
+	 * stopped before they start executing. May be called from any thread.
+	 */
+	void Cancel()
+	{
+		FPlatformAtomics::InterlockedExchange(&bCancelRequested, 1);
+	}
+
+	/** 
+	 * Cancel the command, but only if it hasn't started executing yet, once this returns true 
+	 * the command is guaranteed never to start. May be called from any thread.
+	 * @return true if the command was cancelled.
+	 */
+	bool CancelBeforeStart();
+
+	/** Return true iff Cancel() has been called. */
+	bool IsCancelRequested() const
+	{
+		return bCancelRequested != 0;
+	}
+
+	/** Get the command that is executing on the calling thread, if any. */
+	static FCommand* GetCurrent()
+	{
+		return CurrentCommand;
+	}
+
+	/** 
+	 * Makes a command the current command of the calling thread while in scope, this allows 
+	 * work a command farms out to other threads to be cancelled along with the command.
+	 */
+	class FScopedCurrent
+	{
+	public:
+		FScopedCurrent(FCommand* InCommand)
+		: PreviousCommand(CurrentCommand)
+		{
+			CurrentCommand = InCommand;
+		}
+
+		~FScopedCurrent()
+		{
+			CurrentCommand = PreviousCommand;
+		}
+
+	private:
+		FCommand* PreviousCommand;
+	};
+
 	/** Notify that the command has finished executing. */
 	void NotifyOperationComplete()
 	{
@@ -88,6 +168,12 @@ public:
 		return ContentDirectory;
 	}
 
+	/** Get the cache the command should publish any file states it obtains to. */
+	FFileStateCache& GetFileStateCache() const
+	{
+		return FileStateCache;
+	}
+
 	FSourceControlOperationRef GetOperation() const
 	{
 		return Operation;
@@ -113,12 +199,34 @@ public:
 	{
 		return LargeFiles;
 	}
+
+	/** 
+	 * Set the scheduler that should be notified when the command finishes executing,
+	 * the notification may be sent from a worker thread.
+	 */
+	void SetScheduler(FCommandScheduler* InScheduler)
+	{
+		Scheduler = InScheduler;
+	}
 	
 public:
 	// FQueuedWork methods
 	virtual void DoThreadedWork() override;
 	virtual void Abandon() override;
 
+private:
+	/** Flag the command as executed, after this call the command may be deleted at any time. */
+	void MarkExecuted();
+
+	/** Values of StartState. */
+	enum
+	{
+		NotStarted = 0,
+		Started = 1,
+		/** Cancelled by CancelBeforeStart(), the command won't be started. */
+		CancelledBeforeStart = 2,
+	};
+
 public:
 	/** Descriptions of errors (if any) encountered while executing the command. */
 	TArray<FString> ErrorMessages;
@@ -142,17 +250,38 @@ private:
 	/** Absolute path to the current content directory. */
 	FString ContentDirectory;
 
+	/** Cache of file states owned by the provider, may be updated from any thread. */
+	FFileStateCache& FileStateCache;
+
 	/** Will be set to true if the operation is performed successfully. */
 	bool bCommandSuccessful;
 
 	/** Executed after the operation completes. */
 	FSourceControlOperationComplete OperationCompleteDelegate;
 
+	/** 
+	 * Has a worker thread started executing the operation? Only ever changed from NotStarted 
+	 * (by a compare-and-swap), so either the worker or CancelBeforeStart() gets to claim it.
+	 */
+	volatile int32 StartState;
+
 	/** Has the operation been completed? */
 	volatile int32 bExecuteProcessed;
 
+	/** Has cancellation of the operation been requested? */
+	volatile int32 bCancelRequested;
+
+	/** Triggered when the operation is completed. */
+	FEvent* CompletionEvent;
+
 	/** Is this operation being performed synchronously or asynchronously? */
 	EConcurrency::Type Concurrency;
+
+	/** The scheduler (if any) that dispatched this command to a worker thread. */
+	FCommandScheduler* Scheduler;
+
+	/** The command executing on the current thread. */
+	static thread_local FCommand* CurrentCommand;
 };
 
 } // namespace MercurialSourceControl
@@ -0,0 +1,153 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlCommandMemo.h"
+#include "MercurialSourceControlDirstate.h"
+#include "MercurialSourceControlChangelog.h"
+
+namespace MercurialSourceControl {
+
+namespace 
+{
+	/** Seconds for which results with a partial fingerprint may be reused. */
+	const double MaxPartialEntryAge = 1.0;
+
+	/** 
+	 * The memo is emptied when it reaches this many entries, the same queries tend to be
+	 * repeated within a short time, so there's little point in keeping old entries around.
+	 */
+	const int32 MaxEntries = 64;
+} // unnamed namespace
+
+FRepositoryFingerprint::FRepositoryFingerprint()
+	: DirstateSize(-1)
+	, ChangelogSize(-1)
+	, WorkingFilesHash(0)
+	, bIsPartial(false)
+	, bIsRacy(false)
+{
+}
+
+FRepositoryFingerprint FRepositoryFingerprint::FromRepository(const FString& InRepositoryRoot)
+{
+	FRepositoryFingerprint Fingerprint;
+	IFileManager& FileManager = IFileManager::Get();
+
+	const FFileStatData DirstateData = 
+		FileManager.GetStatData(*FDirstate::GetFilename(InRepositoryRoot));
+	if (DirstateData.bIsValid)
+	{
+		Fingerprint.DirstateSize = DirstateData.FileSize;
+		Fingerprint.DirstateTimeStamp = DirstateData.ModificationTime;
+	}
+
+	// the changelog index is only ever appended to, so its size changes whenever the tip does
+	const FFileStatData ChangelogData = 
+		FileManager.GetStatData(*FChangelog::GetIndexFilename(InRepositoryRoot));
+	if (ChangelogData.bIsValid)
+	{
+		Fingerprint.ChangelogSize = ChangelogData.FileSize;
+		Fingerprint.ChangelogTimeStamp = ChangelogData.ModificationTime;
+	}
+	return Fingerprint;
+}
+
+void FRepositoryFingerprint::AddWorkingFiles(
+	const FString& InWorkingDirectory, const TArray<FString>& InRelativeFiles
+)
+{
+	IFileManager& FileManager = IFileManager::Get();
+	const int64 CurrentSecond = FDateTime::UtcNow().GetTicks() / ETimespan::TicksPerSecond;
+	for (const FString& RelativeFile : InRelativeFiles)
+	{
+		const FFileStatData StatData = FileManager.GetStatData(*(InWorkingDirectory / RelativeFile));
+		if (!StatData.bIsValid)
+		{
+			// the file doesn't exist, which is as much a part of the state as its contents
+			WorkingFilesHash = HashCombine(WorkingFilesHash, 1);
+		}
+		else if (StatData.bIsDirectory)
+		{
+			// the timestamp of a directory doesn't change when the files in it are modified
+			bIsPartial = true;
+		}
+		else
+		{
+			WorkingFilesHash = HashCombine(WorkingFilesHash, GetTypeHash(StatData.FileSize));
+			WorkingFilesHash = HashCombine(
+				WorkingFilesHash, GetTypeHash(StatData.ModificationTime.GetTicks())
+			);
+			bIsRacy |= 
+				(StatData.ModificationTime.GetTicks() / ETimespan::TicksPerSecond) >= CurrentSecond;
+		}
+	}
+}
+
+bool FCommandMemo::Find(
+	const FString& InKey, const FRepositoryFingerprint& InFingerprint, FString& OutResults
+) const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	const FEntry* Entry = Entries.Find(InKey);
+	if (!Entry || (Entry->Fingerprint != InFingerprint))
+	{
+		return false;
+	}
+	if (Entry->Fingerprint.bIsPartial && 
+		((FPlatformTime::Seconds() - Entry->Time) > MaxPartialEntryAge))
+	{
+		return false;
+	}
+	OutResults = Entry->Results;
+	return true;
+}
+
+void FCommandMemo::Add(
+	const FString& InKey, const FRepositoryFingerprint& InFingerprint, const FString& InResults
+)
+{
+	if (InFingerprint.bIsRacy)
+	{
+		return;
+	}
+
+	FScopeLock ScopeLock(&CriticalSection);
+	if (Entries.Num() >= MaxEntries)
+	{
+		Entries.Empty();
+	}
+	FEntry& Entry = Entries.FindOrAdd(InKey);
+	Entry.Fingerprint = InFingerprint;
+	Entry.Time = FPlatformTime::Seconds();
+	Entry.Results = InResults;
+}
+
+void FCommandMemo::Empty()
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	Entries.Empty();
+}
+
+} // namespace MercurialSourceControl
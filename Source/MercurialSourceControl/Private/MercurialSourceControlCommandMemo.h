@@ -0,0 +1,140 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+namespace MercurialSourceControl {
+
+/** 
+ * Identifies the state of a repository that the output of read-only commands depends on, 
+ * without invoking hg. Only file sizes and timestamps are looked at, so it's cheap to compute.
+ */
+struct FRepositoryFingerprint
+{
+	/** Size and timestamp of the dirstate, changes when files are added, removed, committed... */
+	int64 DirstateSize;
+	FDateTime DirstateTimeStamp;
+
+	/** Size and timestamp of the changelog index, changes when a revision is added. */
+	int64 ChangelogSize;
+	FDateTime ChangelogTimeStamp;
+
+	/** Hash of the sizes and timestamps of the working files a command operates on. */
+	uint32 WorkingFilesHash;
+
+	/** 
+	 * Set if the fingerprint may not change when the output of a command does, e.g. when 
+	 * a file within one of the directories a command operates on is modified.
+	 */
+	bool bIsPartial;
+
+	/** 
+	 * Set if one of the working files was modified within the current second, so it could be 
+	 * modified again without its size or (whole second) timestamp changing. Like hg itself 
+	 * does for such "racy clean" files, results with such a fingerprint are never reused.
+	 */
+	bool bIsRacy;
+
+	FRepositoryFingerprint();
+
+	/** 
+	 * Fingerprint the given repository.
+	 * @param InRepositoryRoot Absolute path to the root of the repository, must end in a '/'.
+	 */
+	static FRepositoryFingerprint FromRepository(const FString& InRepositoryRoot);
+
+	/** 
+	 * Include the given working files in the fingerprint, only needed for commands whose
+	 * output depends on the contents of the working directory (e.g. status).
+	 * @param InRelativeFiles Files and directories relative to InWorkingDirectory.
+	 */
+	void AddWorkingFiles(const FString& InWorkingDirectory, const TArray<FString>& InRelativeFiles);
+
+	bool operator==(const FRepositoryFingerprint& Other) const
+	{
+		return (DirstateSize == Other.DirstateSize) 
+			&& (DirstateTimeStamp == Other.DirstateTimeStamp)
+			&& (ChangelogSize == Other.ChangelogSize)
+			&& (ChangelogTimeStamp == Other.ChangelogTimeStamp)
+			&& (WorkingFilesHash == Other.WorkingFilesHash)
+			&& (bIsPartial == Other.bIsPartial);
+	}
+
+	bool operator!=(const FRepositoryFingerprint& Other) const
+	{
+		return !(*this == Other);
+	}
+};
+
+/**
+ * Remembers the output of read-only hg commands, so that the same query made several times in
+ * quick succession (e.g. by the content browser, an asset editor, and the save dialog) only 
+ * invokes hg once.
+ *
+ * Each result is stored along with the fingerprint of the repository taken before the command 
+ * was run, and is only reused while the fingerprint is unchanged. Results with a partial 
+ * fingerprint are also discarded once they're older than a second or so. 
+ *
+ * It's safe to use the memo from any thread.
+ */
+class FCommandMemo
+{
+public:
+	FCommandMemo() {}
+
+	/** 
+	 * Look up the output of a command.
+	 * @param InKey The full command, including options and files.
+	 * @param InFingerprint Current fingerprint of the repository the command operates on.
+	 * @return true if the output was found and is still valid, false otherwise.
+	 */
+	bool Find(
+		const FString& InKey, const FRepositoryFingerprint& InFingerprint, FString& OutResults
+	) const;
+
+	/** 
+	 * Remember the output of a command, unless the fingerprint is racy.
+	 * @param InFingerprint Fingerprint of the repository taken before the command was run.
+	 */
+	void Add(
+		const FString& InKey, const FRepositoryFingerprint& InFingerprint, 
+		const FString& InResults
+	);
+
+	/** Forget all results, e.g. after a command that modifies the repository. */
+	void Empty();
+
+private:
+	struct FEntry
+	{
+		FRepositoryFingerprint Fingerprint;
+		/** When the entry was added, in FPlatformTime::Seconds(). */
+		double Time;
+		FString Results;
+	};
+
+	mutable FCriticalSection CriticalSection;
+	TMap<FString, FEntry> Entries;
+};
+
+} // namespace MercurialSourceControl
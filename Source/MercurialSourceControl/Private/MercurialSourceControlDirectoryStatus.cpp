@@ -0,0 +1,92 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlDirectoryStatus.h"
+
+namespace MercurialSourceControl {
+
+int32* FDirectoryStatus::GetCounter(EFileStatus InStatus)
+{
+	switch (InStatus)
+	{
+		case EFileStatus::Modified:
+			return &NumModified;
+		case EFileStatus::Added:
+			return &NumAdded;
+		case EFileStatus::Removed:
+			return &NumRemoved;
+		case EFileStatus::NotTracked:
+			return &NumNotTracked;
+		case EFileStatus::Missing:
+			return &NumMissing;
+		default:
+			return nullptr;
+	}
+}
+
+void FDirectoryStatusRollup::Update(const TArray<FStatusChange>& InChanges)
+{
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	for (const FStatusChange& Change : InChanges)
+	{
+		Adjust(Change.Key, Change.Value.Key, -1);
+		Adjust(Change.Key, Change.Value.Value, 1);
+	}
+}
+
+FDirectoryStatus FDirectoryStatusRollup::GetStatus(FPathId InDirectoryId) const
+{
+	FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+	const FDirectoryStatus* Status = Directories.Find(InDirectoryId);
+	return Status ? *Status : FDirectoryStatus();
+}
+
+void FDirectoryStatusRollup::Empty()
+{
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	Directories.Empty();
+}
+
+void FDirectoryStatusRollup::Adjust(FPathId InPathId, EFileStatus InStatus, int32 InDelta)
+{
+	if (!FDirectoryStatus().GetCounter(InStatus))
+	{
+		return;
+	}
+
+	const FPathTable& PathTable = FPathTable::Get();
+	for (FPathId DirectoryId = PathTable.GetParent(InPathId); DirectoryId != INDEX_NONE; 
+		DirectoryId = PathTable.GetParent(DirectoryId))
+	{
+		FDirectoryStatus& Status = Directories.FindOrAdd(DirectoryId);
+		*Status.GetCounter(InStatus) += InDelta;
+		if (Status.IsEmpty())
+		{
+			Directories.Remove(DirectoryId);
+		}
+	}
+}
+
+} // namespace MercurialSourceControl
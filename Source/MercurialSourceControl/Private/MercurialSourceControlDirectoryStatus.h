@@ -0,0 +1,97 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+#include "MercurialSourceControlFileState.h"
+
+namespace MercurialSourceControl {
+
+/** Number of files with each status of interest within a directory, including subdirectories. */
+struct FDirectoryStatus
+{
+	int32 NumModified;
+	int32 NumAdded;
+	int32 NumRemoved;
+	int32 NumNotTracked;
+	int32 NumMissing;
+
+	FDirectoryStatus()
+		: NumModified(0)
+		, NumAdded(0)
+		, NumRemoved(0)
+		, NumNotTracked(0)
+		, NumMissing(0)
+	{
+	}
+
+	/** Check if the directory contains any files that have been added, removed or modified. */
+	bool HasChanges() const
+	{
+		return (NumModified > 0) || (NumAdded > 0) || (NumRemoved > 0) || (NumMissing > 0);
+	}
+
+	/** Check if all the counters are zero. */
+	bool IsEmpty() const
+	{
+		return (NumModified == 0) && (NumAdded == 0) && (NumRemoved == 0) && 
+			(NumNotTracked == 0) && (NumMissing == 0);
+	}
+
+	/** Get the counter for the given status, or null if files with that status aren't counted. */
+	int32* GetCounter(EFileStatus InStatus);
+};
+
+/**
+ * Per-directory counts of files that are modified, added, removed, untracked or missing.
+ *
+ * Each file status change is propagated to all the ancestors of the file in the FPathTable, 
+ * so the status of any directory can be summarized without visiting the files within it.
+ * Directories that don't contain any counted files take up no space.
+ * It's safe to use from any thread.
+ */
+class FDirectoryStatusRollup
+{
+public:
+	/** A file whose status changed from Key to Value. */
+	typedef TPair<FPathId, TPair<EFileStatus, EFileStatus>> FStatusChange;
+
+	/** Apply the given status changes to the counts of all the directories containing the files. */
+	void Update(const TArray<FStatusChange>& InChanges);
+
+	/** Get the counts for the given directory. */
+	FDirectoryStatus GetStatus(FPathId InDirectoryId) const;
+
+	/** Reset the counts of all directories to zero. */
+	void Empty();
+
+private:
+	/** @note The caller must hold a write lock. */
+	void Adjust(FPathId InPathId, EFileStatus InStatus, int32 InDelta);
+
+private:
+	mutable FRWLock Lock;
+	TMap<FPathId, FDirectoryStatus> Directories;
+};
+
+} // namespace MercurialSourceControl
@@ -0,0 +1,180 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlDirstate.h"
+#include "MercurialSourceControlChangelog.h"
+#if PLATFORM_WINDOWS
+#include "WindowsHWrapper.h"
+#endif // PLATFORM_WINDOWS
+
+namespace MercurialSourceControl {
+
+namespace 
+{
+	/** 
+	 * Marker at the start of the docket file used by the dirstate-v2 format, it's followed by 
+	 * the parents, each of which is padded to 32 bytes. 
+	 * The original format doesn't have a marker, the parents are stored in the first 40 bytes.
+	 */
+	const ANSICHAR DirstateV2Marker[] = "dirstate-v2\n";
+	const int32 DirstateV2MarkerLen = ARRAY_COUNT(DirstateV2Marker) - 1;
+	const int32 DirstateV2NodeSize = 32;
+
+	/** 
+	 * Size of the fixed part of each entry in the original format: a state character, followed
+	 * by the mode, size, and modification time of the file, and the length of the filename, 
+	 * all of which are big-endian 32-bit integers.
+	 */
+	const int32 EntryHeaderSize = 17;
+	const int32 EntryNameLengthOffset = 13;
+
+	/** 
+	 * Decode a filename stored in the dirstate, hg stores filenames in the system's default 
+	 * code page on Windows, and as they are (i.e. almost always UTF-8) everywhere else.
+	 */
+	FString DecodeFilename(const uint8* InBytes, int32 InNumBytes)
+	{
+#if PLATFORM_WINDOWS
+		const int32 Length = ::MultiByteToWideChar(
+			CP_ACP, 0, (LPCSTR)InBytes, InNumBytes, nullptr, 0
+		);
+		TArray<TCHAR> Chars;
+		Chars.SetNumUninitialized(Length);
+		::MultiByteToWideChar(CP_ACP, 0, (LPCSTR)InBytes, InNumBytes, Chars.GetData(), Length);
+		return FString(Length, Chars.GetData());
+#else
+		FUTF8ToTCHAR Converter((const ANSICHAR*)InBytes, InNumBytes);
+		return FString(Converter.Length(), Converter.Get());
+#endif // PLATFORM_WINDOWS
+	}
+} // unnamed namespace
+
+FString FDirstateParents::GetFirstParentHex() const
+{
+	return BytesToHex(Nodes, NodeSize).ToLower();
+}
+
+FString FDirstate::GetFilename(const FString& InRepositoryRoot)
+{
+	return InRepositoryRoot + TEXT(".hg/dirstate");
+}
+
+bool FDirstate::ReadParents(const FString& InRepositoryRoot, FDirstateParents& OutParents)
+{
+	TUniquePtr<FArchive> Reader(
+		IFileManager::Get().CreateFileReader(*GetFilename(InRepositoryRoot), FILEREAD_Silent)
+	);
+	if (!Reader)
+	{
+		return false;
+	}
+
+	uint8 Header[DirstateV2MarkerLen + 2 * DirstateV2NodeSize];
+	const int64 HeaderLen = FMath::Min<int64>(Reader->TotalSize(), sizeof(Header));
+	if (HeaderLen < sizeof(OutParents.Nodes))
+	{
+		return false;
+	}
+	Reader->Serialize(Header, HeaderLen);
+	if (Reader->IsError())
+	{
+		return false;
+	}
+
+	if ((HeaderLen == sizeof(Header)) 
+		&& (FMemory::Memcmp(Header, DirstateV2Marker, DirstateV2MarkerLen) == 0))
+	{
+		const uint8* Parent = Header + DirstateV2MarkerLen;
+		FMemory::Memcpy(OutParents.Nodes, Parent, FDirstateParents::NodeSize);
+		FMemory::Memcpy(
+			OutParents.Nodes + FDirstateParents::NodeSize, Parent + DirstateV2NodeSize, 
+			FDirstateParents::NodeSize
+		);
+	}
+	else
+	{
+		FMemory::Memcpy(OutParents.Nodes, Header, sizeof(OutParents.Nodes));
+	}
+	return true;
+}
+
+bool FDirstate::ReadTrackedFiles(const FString& InRepositoryRoot, TArray<FString>& OutFiles)
+{
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *GetFilename(InRepositoryRoot), FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	const int32 ParentsSize = 2 * FDirstateParents::NodeSize;
+	if ((Data.Num() < ParentsSize) || 
+		((Data.Num() >= DirstateV2MarkerLen) && 
+		 (FMemory::Memcmp(Data.GetData(), DirstateV2Marker, DirstateV2MarkerLen) == 0)))
+	{
+		return false;
+	}
+
+	int32 Offset = ParentsSize;
+	while (Offset < Data.Num())
+	{
+		if (Data.Num() - Offset < EntryHeaderSize)
+		{
+			return false;
+		}
+		const uint8 State = Data[Offset];
+		const uint8* LengthBytes = Data.GetData() + Offset + EntryNameLengthOffset;
+		const uint32 NameLength = ((uint32)LengthBytes[0] << 24) | ((uint32)LengthBytes[1] << 16) 
+			| ((uint32)LengthBytes[2] << 8) | (uint32)LengthBytes[3];
+		Offset += EntryHeaderSize;
+		if (NameLength > (uint32)(Data.Num() - Offset))
+		{
+			return false;
+		}
+
+		// the state is one of n(ormal), a(dded), r(emoved), or m(erged)
+		if (State != 'r')
+		{
+			// copied files have the name of the source appended after a null character
+			const uint8* Name = Data.GetData() + Offset;
+			int32 NumBytes = 0;
+			while ((NumBytes < (int32)NameLength) && (Name[NumBytes] != 0))
+			{
+				++NumBytes;
+			}
+			OutFiles.Add(DecodeFilename(Name, NumBytes));
+		}
+		Offset += NameLength;
+	}
+	return true;
+}
+
+bool FDirstate::ReadFirstParentRevision(const FString& InRepositoryRoot, int32& OutRevision)
+{
+	FDirstateParents Parents;
+	return ReadParents(InRepositoryRoot, Parents) 
+		&& FChangelog::FindRevision(InRepositoryRoot, Parents.Nodes, OutRevision);
+}
+
+} // namespace MercurialSourceControl
@@ -0,0 +1,99 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+namespace MercurialSourceControl {
+
+/** The node IDs of the parent revisions of a working directory. */
+struct FDirstateParents
+{
+	/** Size of a binary Mercurial node ID (a SHA-1 hash). */
+	static const int32 NodeSize = 20;
+
+	/** The first parent, followed by the second parent (all zeros unless merging). */
+	uint8 Nodes[2 * NodeSize];
+
+	FDirstateParents()
+	{
+		FMemory::Memzero(Nodes);
+	}
+
+	bool operator==(const FDirstateParents& Other) const
+	{
+		return FMemory::Memcmp(Nodes, Other.Nodes, sizeof(Nodes)) == 0;
+	}
+
+	bool operator!=(const FDirstateParents& Other) const
+	{
+		return !(*this == Other);
+	}
+
+	/** Get the hexadecimal form of the first parent, as printed by hg. */
+	FString GetFirstParentHex() const;
+
+	friend FArchive& operator<<(FArchive& Ar, FDirstateParents& Parents)
+	{
+		Ar.Serialize(Parents.Nodes, sizeof(Parents.Nodes));
+		return Ar;
+	}
+};
+
+/** 
+ * Reads information directly from the .hg/dirstate file of a repository, this is much cheaper
+ * than spawning hg but only works for information that's in a well known location in the file.
+ */
+class FDirstate
+{
+public:
+	/** 
+	 * Read the parents of the working directory.
+	 * @param InRepositoryRoot Absolute path to the root of the repository, must end in a '/'.
+	 * @return false if the dirstate file couldn't be read or is in an unknown format.
+	 */
+	static bool ReadParents(const FString& InRepositoryRoot, FDirstateParents& OutParents);
+
+	/**
+	 * Read the local revision number of the first parent of the working directory.
+	 * @param InRepositoryRoot Absolute path to the root of the repository, must end in a '/'.
+	 * @param OutRevision Will be set to the revision number, or -1 if there is no parent 
+	 *                    (i.e. nothing has been committed yet).
+	 * @return false if the dirstate or changelog couldn't be read.
+	 */
+	static bool ReadFirstParentRevision(const FString& InRepositoryRoot, int32& OutRevision);
+
+	/**
+	 * Read the filenames of all the files tracked in the working directory, i.e. all the files
+	 * in the dirstate except those that have been removed.
+	 * @param InRepositoryRoot Absolute path to the root of the repository, must end in a '/'.
+	 * @param OutFiles Will be filled in with filenames relative to the repository root.
+	 * @return false if the dirstate file couldn't be read, or is in the dirstate-v2 format 
+	 *         (which isn't understood).
+	 */
+	static bool ReadTrackedFiles(const FString& InRepositoryRoot, TArray<FString>& OutFiles);
+
+	/** Get the absolute filename of the dirstate file of the given repository. */
+	static FString GetFilename(const FString& InRepositoryRoot);
+};
+
+} // namespace MercurialSourceControl
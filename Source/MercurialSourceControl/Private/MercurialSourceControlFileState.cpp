@@ -30,19 +30,40 @@ namespace MercurialSourceControl {
 
 #define LOCTEXT_NAMESPACE "MercurialSourceControl.State"
 
+FRWLock FFileState::HistoryLock;
+
+FFileState::FFileState(const FFileState& InOther)
+	: PathId(InOther.PathId)
+	, FileStatus(InOther.FileStatus)
+	, TrackedHint(InOther.TrackedHint)
+	, TimeStamp(InOther.TimeStamp)
+{
+	FRWScopeLock ReadLock(HistoryLock, SLT_ReadOnly);
+	History = InOther.History;
+}
+
+void FFileState::SetHistory(const TArray<FFileRevisionRef>& InFileRevisions)
+{
+	FRWScopeLock WriteLock(HistoryLock, SLT_Write);
+	History = InFileRevisions;
+}
+
 int32 FFileState::GetHistorySize() const
 {
+	FRWScopeLock ReadLock(HistoryLock, SLT_ReadOnly);
 	return History.Num();
 }
 
 FSourceControlRevisionPtr FFileState::GetHistoryItem(int32 HistoryIndex) const
 {
-	check(History.IsValidIndex(HistoryIndex));
-	return History[HistoryIndex];
+	FRWScopeLock ReadLock(HistoryLock, SLT_ReadOnly);
+	// the history may have been replaced since the caller got its size
+	return History.IsValidIndex(HistoryIndex) ? History[HistoryIndex] : nullptr;
 }
 
 FSourceControlRevisionPtr FFileState::FindHistoryRevision(int32 RevisionNumber) const
 {
+	FRWScopeLock ReadLock(HistoryLock, SLT_ReadOnly);
 	for (int32 i = 0; i < History.Num(); ++i)
 	{
 		if (History[i]->GetRevisionNumber() == RevisionNumber)
@@ -55,6 +76,7 @@ FSourceControlRevisionPtr FFileState::FindHistoryRevision(int32 RevisionNumber)
 
 FSourceControlRevisionPtr FFileState::FindHistoryRevision(const FString& InRevision) const
 {
+	FRWScopeLock ReadLock(HistoryLock, SLT_ReadOnly);
 	for (int32 i = 0; i < History.Num(); ++i)
 	{
 		if (History[i]->GetRevision() == InRevision)
@@ -190,9 +212,34 @@ FText FFileState::GetDisplayTooltip() const
 	return FText();
 }
 
+FFileState& FFileState::operator=(const FFileState& InOther)
+{
+	if (this != &InOther)
+	{
+		{
+			FRWScopeLock WriteLock(HistoryLock, SLT_Write);
+			History = InOther.History;
+		}
+		PathId = InOther.PathId;
+		FileStatus = InOther.FileStatus;
+		TrackedHint = InOther.TrackedHint;
+		TimeStamp = InOther.TimeStamp;
+	}
+	return *this;
+}
+
 const FString& FFileState::GetFilename() const
 {
-	return AbsoluteFilename;
+	// The interface wants a reference, but keeping the filename in the state would bring back 
+	// the memory interning saves. Instead it's built into one of a few buffers owned by the 
+	// calling thread, which the editor is done with (or has copied) long before it's reused.
+	static const int32 NumBuffers = 8;
+	static thread_local FString Buffers[NumBuffers];
+	static thread_local int32 NextBuffer = 0;
+	FString& Buffer = Buffers[NextBuffer];
+	NextBuffer = (NextBuffer + 1) % NumBuffers;
+	GetFilename(Buffer);
+	return Buffer;
 }
 
 const FDateTime& FFileState::GetTimeStamp() const
@@ -236,7 +283,12 @@ bool FFileState::IsCurrent() const
 
 bool FFileState::IsSourceControlled() const
 {
-	return (FileStatus != EFileStatus::NotTracked) && (FileStatus != EFileStatus::Unknown);
+	// the tracked manifest can answer this long before the status has been retrieved
+	if (FileStatus == EFileStatus::Unknown)
+	{
+		return TrackedHint == ETrackedHint::Tracked;
+	}
+	return FileStatus != EFileStatus::NotTracked;
 }
 
 bool FFileState::IsAdded() const
@@ -287,6 +339,10 @@ bool FFileState::IsModified() const
 
 bool FFileState::CanAdd() const
 {
+	if (FileStatus == EFileStatus::Unknown)
+	{
+		return TrackedHint == ETrackedHint::NotTracked;
+	}
 	return FileStatus == EFileStatus::NotTracked;
 }
 
@@ -25,6 +25,7 @@
 
 #include "ISourceControlState.h"
 #include "MercurialSourceControlFileRevision.h"
+#include "MercurialSourceControlPathTable.h"
 
 namespace MercurialSourceControl {
 
@@ -40,9 +41,23 @@ enum class EFileStatus
 	Missing,
 };
 
+/** What the tracked manifest says about a file whose status hasn't been retrieved yet. */
+enum class ETrackedHint : uint8
+{
+	/** The manifest hasn't been built, or has no opinion. */
+	None,
+	Tracked,
+	/** Not tracked, within the repository, and not ignored, so the file could be added. */
+	NotTracked,
+};
+
 /**
  * Provides information relating to the current status of a file in a Mercurial repository,
  * and the revision history of that file.
+ * States held by the file state cache are updated in place (by whichever thread publishes the
+ * update), so any references the editor holds keep reflecting the latest known status.
+ * The status, tracked hint and timestamp are small enough to be read while they're being
+ * written, the history is guarded by a lock shared by all states.
  */
 class FFileState
 	: public ISourceControlState
@@ -50,12 +65,40 @@ class FFileState
 {
 public:
 	FFileState(const FString& InFilename)
-		: AbsoluteFilename(InFilename)
+		: PathId(FPathTable::Get().Intern(InFilename))
+		, FileStatus(EFileStatus::Unknown)
+		, TrackedHint(ETrackedHint::None)
+		, TimeStamp(0)
+	{
+	}
+
+	FFileState(FPathId InPathId)
+		: PathId(InPathId)
 		, FileStatus(EFileStatus::Unknown)
+		, TrackedHint(ETrackedHint::None)
 		, TimeStamp(0)
 	{
 	}
 
+	FFileState(const FFileState& InOther);
+
+	FFileState& operator=(const FFileState& InOther);
+
+	/** Get the ID of the absolute filename of this file in the FPathTable. */
+	FPathId GetPathId() const
+	{
+		return PathId;
+	}
+
+	/** 
+	 * Build the absolute filename of this file into the given buffer, unlike GetFilename()
+	 * this leaves the caller in charge of the memory it takes up.
+	 */
+	void GetFilename(FString& OutFilename) const
+	{
+		FPathTable::Get().GetPath(PathId, OutFilename);
+	}
+
 	void SetFileStatus(EFileStatus InFileStatus)
 	{
 		FileStatus = InFileStatus;
@@ -66,16 +109,27 @@ public:
 		return FileStatus;
 	}
 
-	void SetTimeStamp(const FDateTime& InTimeStamp)
+	/** 
+	 * Set whether the file is tracked according to the tracked manifest, this is only used 
+	 * while the status of the file is unknown.
+	 */
+	void SetTrackedHint(ETrackedHint InTrackedHint)
 	{
-		TimeStamp = InTimeStamp;
+		TrackedHint = InTrackedHint;
+	}
+
+	ETrackedHint GetTrackedHint() const
+	{
+		return TrackedHint;
 	}
 
-	void SetHistory(const TArray<FFileRevisionRef>& InFileRevisions)
+	void SetTimeStamp(const FDateTime& InTimeStamp)
 	{
-		History = InFileRevisions;
+		TimeStamp = InTimeStamp;
 	}
 
+	void SetHistory(const TArray<FFileRevisionRef>& InFileRevisions);
+
 public:
 	// ISourceControlState methods
 
@@ -117,8 +171,16 @@ private:
 	/** All the revisions of the file */
 	TArray<FFileRevisionRef> History;
 
-	FString AbsoluteFilename;
+	/** 
+	 * Guards the history of every state, it's rarely written so there's no point in giving 
+	 * each state a lock of its own.
+	 */
+	static FRWLock HistoryLock;
+
+	/** The absolute filename, interned to avoid storing a copy of it in every state. */
+	FPathId PathId;
 	EFileStatus FileStatus;
+	ETrackedHint TrackedHint;
 
 	/** 
 	 * Last time the state was updated.
@@ -0,0 +1,211 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlFileStateCache.h"
+
+namespace MercurialSourceControl {
+
+FFileStateRef FFileStateCache::FindOrAdd(FPathId InPathId)
+{
+	FShard& Shard = Shards[GetShardIndex(InPathId)];
+	TSharedPtr<FFileState, ESPMode::ThreadSafe> State;
+	{
+		FRWScopeLock ReadLock(Shard.Lock, SLT_ReadOnly);
+		if (const FFileStateRef* StatePtr = Shard.States.Find(InPathId))
+		{
+			State = *StatePtr;
+		}
+	}
+
+	if (!State.IsValid())
+	{
+		FRWScopeLock WriteLock(Shard.Lock, SLT_Write);
+		// another thread may have added the state while the lock was released
+		const FFileStateRef* StatePtr = Shard.States.Find(InPathId);
+		State = StatePtr ? *StatePtr : Shard.Add(InPathId);
+	}
+
+	// The hint only matters (and so is only looked up) while the status is unknown. It doesn't
+	// affect the status index so it doesn't need the write lock, any threads setting it at the 
+	// same time will be setting it to what the manifest currently says.
+	if (State->GetFileStatus() == EFileStatus::Unknown)
+	{
+		State->SetTrackedHint(TrackedManifest.GetHint(InPathId));
+	}
+	return State.ToSharedRef();
+}
+
+bool FFileStateCache::Update(const TArray<FFileState>& InStates, TArray<FPathId>& OutChangedFiles)
+{
+	const int32 NumChangedFiles = OutChangedFiles.Num();
+
+	// split the states into per-shard buckets so each shard only needs to be locked once
+	TArray<const FFileState*> Buckets[NumShards];
+	TArray<TPair<FPathId, bool>> TrackedChanges;
+	TrackedChanges.Reserve(InStates.Num());
+	for (const auto& State : InStates)
+	{
+		Buckets[GetShardIndex(State.GetPathId())].Add(&State);
+		const EFileStatus Status = State.GetFileStatus();
+		if (Status != EFileStatus::Unknown)
+		{
+			// removed files are still in the repository, but not in the working directory
+			const bool bIsTracked = (Status != EFileStatus::NotTracked) && 
+				(Status != EFileStatus::Ignored) && (Status != EFileStatus::Removed);
+			TrackedChanges.Emplace(State.GetPathId(), bIsTracked);
+		}
+	}
+	TrackedManifest.Update(TrackedChanges);
+
+	TArray<FDirectoryStatusRollup::FStatusChange> StatusChanges;
+	for (int32 ShardIndex = 0; ShardIndex < NumShards; ++ShardIndex)
+	{
+		if (Buckets[ShardIndex].Num() == 0)
+		{
+			continue;
+		}
+
+		FShard& Shard = Shards[ShardIndex];
+		FRWScopeLock WriteLock(Shard.Lock, SLT_Write);
+		StatusChanges.Reset();
+		for (const FFileState* State : Buckets[ShardIndex])
+		{
+			// only the status of the cached state is updated, its history is preserved
+			const FFileStateRef* CachedStatePtr = Shard.States.Find(State->GetPathId());
+			FFileState& CachedState = CachedStatePtr ? 
+				**CachedStatePtr : *Shard.Add(State->GetPathId());
+			const EFileStatus OldStatus = CachedState.GetFileStatus();
+			if (OldStatus == State->GetFileStatus())
+			{
+				// the status has just been verified, but listeners don't need to hear about it
+				CachedState.SetTimeStamp(State->GetTimeStamp());
+				continue;
+			}
+			StatusChanges.Emplace(
+				State->GetPathId(), MakeTuple(OldStatus, State->GetFileStatus())
+			);
+			Shard.SetStatus(CachedState, State->GetFileStatus());
+			CachedState.SetTimeStamp(State->GetTimeStamp());
+			OutChangedFiles.Add(State->GetPathId());
+		}
+		// applied while the shard is still locked so changes to any one file are rolled up 
+		// in the same order they're made to the cache
+		DirectoryStatusRollup.Update(StatusChanges);
+	}
+	return OutChangedFiles.Num() > NumChangedFiles;
+}
+
+bool FFileStateCache::Update(
+	const TMap<FString, TArray<FFileRevisionRef> >& InFileRevisionsMap, 
+	TArray<FPathId>& OutChangedFiles
+)
+{
+	const FDateTime Now = FDateTime::Now();
+	for (auto It(InFileRevisionsMap.CreateConstIterator()); It; ++It)
+	{
+		const FPathId PathId = FPathTable::Get().Intern(It.Key());
+		FShard& Shard = Shards[GetShardIndex(PathId)];
+		FRWScopeLock WriteLock(Shard.Lock, SLT_Write);
+		const FFileStateRef* CachedStatePtr = Shard.States.Find(PathId);
+		FFileState& CachedState = CachedStatePtr ? **CachedStatePtr : *Shard.Add(PathId);
+		CachedState.SetHistory(It.Value());
+		CachedState.SetTimeStamp(Now);
+		OutChangedFiles.Add(PathId);
+	}
+	return InFileRevisionsMap.Num() > 0;
+}
+
+void FFileStateCache::GetStatesByPredicate(
+	TFunctionRef<bool(const FFileStateRef&)> Predicate, TArray<FFileStateRef>& OutStates
+) const
+{
+	// The predicate is evaluated outside the locks because it may well call back into the 
+	// provider, so the status of a state may change while the predicate is looking at it.
+	TArray<FFileStateRef> ShardStates;
+	for (const FShard& Shard : Shards)
+	{
+		ShardStates.Reset();
+		{
+			FRWScopeLock ReadLock(Shard.Lock, SLT_ReadOnly);
+			Shard.States.GenerateValueArray(ShardStates);
+		}
+
+		for (const auto& State : ShardStates)
+		{
+			if (Predicate(State))
+			{
+				OutStates.Add(State);
+			}
+		}
+	}
+}
+
+void FFileStateCache::GetStatesWithStatus(
+	const TArray<EFileStatus>& InStatuses, TArray<FFileStateRef>& OutStates
+) const
+{
+	for (const FShard& Shard : Shards)
+	{
+		FRWScopeLock ReadLock(Shard.Lock, SLT_ReadOnly);
+		for (EFileStatus Status : InStatuses)
+		{
+			for (FPathId PathId : Shard.StatusIndex[static_cast<int32>(Status)])
+			{
+				OutStates.Add(Shard.States.FindChecked(PathId));
+			}
+		}
+	}
+}
+
+void FFileStateCache::Empty()
+{
+	for (FShard& Shard : Shards)
+	{
+		FRWScopeLock WriteLock(Shard.Lock, SLT_Write);
+		Shard.States.Empty();
+		for (auto& StatusIndex : Shard.StatusIndex)
+		{
+			StatusIndex.Empty();
+		}
+	}
+	TrackedManifest.Empty();
+	DirectoryStatusRollup.Empty();
+}
+
+const FFileStateRef& FFileStateCache::FShard::Add(FPathId InPathId)
+{
+	StatusIndex[static_cast<int32>(EFileStatus::Unknown)].Add(InPathId);
+	return States.Add(InPathId, MakeShareable(new FFileState(InPathId)));
+}
+
+void FFileStateCache::FShard::SetStatus(FFileState& InState, EFileStatus InStatus)
+{
+	const FPathId PathId = InState.GetPathId();
+	StatusIndex[static_cast<int32>(InState.GetFileStatus())].Remove(PathId);
+	StatusIndex[static_cast<int32>(InStatus)].Add(PathId);
+	InState.SetFileStatus(InStatus);
+}
+
+} // namespace MercurialSourceControl
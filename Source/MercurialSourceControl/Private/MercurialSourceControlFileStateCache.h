@@ -0,0 +1,148 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+#include "MercurialSourceControlFileState.h"
+#include "MercurialSourceControlTrackedManifest.h"
+#include "MercurialSourceControlDirectoryStatus.h"
+
+namespace MercurialSourceControl {
+
+/**
+ * Thread-safe cache of file states.
+ *
+ * States are keyed by the IDs of their interned filenames. The cache is split into a number of
+ * shards, each guarded by its own reader/writer lock, so workers can publish states from their 
+ * own threads while the main thread reads from the cache.
+ * Cached states are updated in place while the shard is locked, so a state obtained from the 
+ * cache keeps reflecting the latest status of its file (see FFileState for what that means for 
+ * readers).
+ * Each shard also indexes its states by status, so states with a particular status can be 
+ * retrieved without scanning the whole cache.
+ * The cache also keeps the tracked manifest up to date with the states it's given, and uses it
+ * to hint whether files whose status is still unknown are tracked, and rolls up the status 
+ * changes into per-directory counts.
+ */
+class FFileStateCache
+{
+public:
+	/** Get the cached state of the given file, if that fails create and cache a default state. */
+	FFileStateRef FindOrAdd(const FString& InFilename)
+	{
+		return FindOrAdd(FPathTable::Get().Intern(InFilename));
+	}
+
+	/** 
+	 * Get the cached state of the given file, if that fails create and cache a default state.
+	 * If the status of the file is unknown the state will carry a hint from the tracked manifest.
+	 */
+	FFileStateRef FindOrAdd(FPathId InPathId);
+
+	/** 
+	 * Update the cache with the status of the given file states.
+	 * States whose status matches the cached status only have their timestamp refreshed, and 
+	 * aren't considered to have changed.
+	 * @param OutChangedFiles The IDs of any files whose status changed will be appended to this.
+	 * @return true if any states were updated.
+	 */
+	bool Update(const TArray<FFileState>& InStates, TArray<FPathId>& OutChangedFiles);
+
+	/** 
+	 * Update the cache with the given file revisions.
+	 * @param OutChangedFiles The IDs of any files whose history changed will be appended to this.
+	 * @return true if any states were updated.
+	 */
+	bool Update(
+		const TMap<FString, TArray<FFileRevisionRef> >& InFileRevisionsMap, 
+		TArray<FPathId>& OutChangedFiles
+	);
+
+	/** Get all the cached states that match the given predicate. */
+	void GetStatesByPredicate(
+		TFunctionRef<bool(const FFileStateRef&)> Predicate, TArray<FFileStateRef>& OutStates
+	) const;
+
+	/** Get all the cached states whose status matches one of the given statuses. */
+	void GetStatesWithStatus(
+		const TArray<EFileStatus>& InStatuses, TArray<FFileStateRef>& OutStates
+	) const;
+
+	/** 
+	 * Get the number of modified, added, removed, untracked and missing files within the 
+	 * given directory (including subdirectories), without visiting any of the files.
+	 */
+	FDirectoryStatus GetDirectoryStatus(FPathId InDirectoryId) const
+	{
+		return DirectoryStatusRollup.GetStatus(InDirectoryId);
+	}
+
+	/** Remove all states from the cache, and empty the tracked manifest and directory counts. */
+	void Empty();
+
+	FTrackedManifest& GetTrackedManifest()
+	{
+		return TrackedManifest;
+	}
+
+	const FTrackedManifest& GetTrackedManifest() const
+	{
+		return TrackedManifest;
+	}
+
+private:
+	static const int32 NumShards = 16;
+	static const int32 NumStatuses = static_cast<int32>(EFileStatus::Missing) + 1;
+
+	struct FShard
+	{
+		mutable FRWLock Lock;
+		TMap<FPathId, FFileStateRef> States;
+		/** IDs of the states in States indexed by status. */
+		TSet<FPathId> StatusIndex[NumStatuses];
+
+		/** 
+		 * Add a default state for the given file to the shard.
+		 * @note The caller must hold a write lock.
+		 */
+		const FFileStateRef& Add(FPathId InPathId);
+
+		/** 
+		 * Change the status of a state in the shard, and reindex it.
+		 * @note The caller must hold a write lock.
+		 */
+		void SetStatus(FFileState& InState, EFileStatus InStatus);
+	};
+
+	static int32 GetShardIndex(FPathId InPathId)
+	{
+		return InPathId % NumShards;
+	}
+
+private:
+	FShard Shards[NumShards];
+	FTrackedManifest TrackedManifest;
+	FDirectoryStatusRollup DirectoryStatusRollup;
+};
+
+} // namespace MercurialSourceControl
@@ -0,0 +1,161 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlFileStateSnapshot.h"
+#include "MercurialSourceControlFileStateCache.h"
+#include "MercurialSourceControlDirstate.h"
+
+namespace MercurialSourceControl {
+
+namespace 
+{
+	const uint32 SnapshotMagic = 0x53534748; // "HGSS"
+	/** Must be bumped whenever the snapshot format or EFileStatus changes. */
+	const int32 SnapshotVersion = 1;
+} // unnamed namespace
+
+FString FFileStateSnapshot::GetFilename()
+{
+	return FPaths::ProjectIntermediateDir() / TEXT("MercurialSourceControl/FileStates.bin");
+}
+
+bool FFileStateSnapshot::Save(
+	const FString& InRepositoryRoot, const FFileStateCache& InFileStateCache
+)
+{
+	FDirstateParents Parents;
+	if (!FDirstate::ReadParents(InRepositoryRoot, Parents))
+	{
+		Delete();
+		return false;
+	}
+
+	// there's no point in storing states the editor will have to query anyway, the status 
+	// index lets those be skipped without visiting them
+	TArray<FFileStateRef> KnownStates;
+	InFileStateCache.GetStatesWithStatus(
+		{
+			EFileStatus::Clean, EFileStatus::Added, EFileStatus::Removed, 
+			EFileStatus::Modified, EFileStatus::NotTracked, EFileStatus::Ignored, 
+			EFileStatus::Missing
+		},
+		KnownStates
+	);
+	// filenames are built into a single buffer, there's no need for a copy of every one of them
+	FString Filename;
+	TArray<FFileStateRef> FileStates;
+	FileStates.Reserve(KnownStates.Num());
+	for (const FFileStateRef& FileState : KnownStates)
+	{
+		FileState->GetFilename(Filename);
+		if (Filename.StartsWith(InRepositoryRoot, ESearchCase::CaseSensitive))
+		{
+			FileStates.Add(FileState);
+		}
+	}
+
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*GetFilename()));
+	if (!Writer)
+	{
+		return false;
+	}
+
+	uint32 Magic = SnapshotMagic;
+	int32 Version = SnapshotVersion;
+	FString RepositoryRoot = InRepositoryRoot;
+	int32 NumFileStates = FileStates.Num();
+	*Writer << Magic << Version << RepositoryRoot << Parents << NumFileStates;
+	for (const auto& FileState : FileStates)
+	{
+		// filenames are stored relative to the repository root to keep the snapshot small
+		FileState->GetFilename(Filename);
+		FString RelativeFilename = Filename.RightChop(InRepositoryRoot.Len());
+		uint8 FileStatus = static_cast<uint8>(FileState->GetFileStatus());
+		*Writer << RelativeFilename << FileStatus;
+	}
+	return Writer->Close();
+}
+
+bool FFileStateSnapshot::Load(TArray<FFileState>& OutFileStates)
+{
+	TUniquePtr<FArchive> Reader(
+		IFileManager::Get().CreateFileReader(*GetFilename(), FILEREAD_Silent)
+	);
+	if (!Reader)
+	{
+		return false;
+	}
+
+	uint32 Magic = 0;
+	int32 Version = 0;
+	*Reader << Magic << Version;
+	if (Reader->IsError() || (Magic != SnapshotMagic) || (Version != SnapshotVersion))
+	{
+		return false;
+	}
+
+	FString RepositoryRoot;
+	FDirstateParents SnapshotParents;
+	int32 NumFileStates = 0;
+	*Reader << RepositoryRoot << SnapshotParents << NumFileStates;
+	// each state takes up at least 5 bytes (an empty string and a status)
+	if (Reader->IsError() || (NumFileStates < 0) || (NumFileStates > Reader->TotalSize() / 5))
+	{
+		return false;
+	}
+
+	FDirstateParents CurrentParents;
+	if (!FDirstate::ReadParents(RepositoryRoot, CurrentParents) 
+		|| (CurrentParents != SnapshotParents))
+	{
+		return false;
+	}
+
+	const int32 MaxFileStatus = static_cast<int32>(EFileStatus::Missing);
+	TArray<FFileState> FileStates;
+	FileStates.Reserve(NumFileStates);
+	for (int32 i = 0; i < NumFileStates; ++i)
+	{
+		FString RelativeFilename;
+		uint8 FileStatus = 0;
+		*Reader << RelativeFilename << FileStatus;
+		if (Reader->IsError() || (FileStatus > MaxFileStatus))
+		{
+			return false;
+		}
+		FFileState FileState(RepositoryRoot + RelativeFilename);
+		FileState.SetFileStatus(static_cast<EFileStatus>(FileStatus));
+		FileStates.Add(FileState);
+	}
+	OutFileStates.Append(FileStates);
+	return true;
+}
+
+void FFileStateSnapshot::Delete()
+{
+	IFileManager::Get().Delete(*GetFilename(), false, false, true);
+}
+
+} // namespace MercurialSourceControl
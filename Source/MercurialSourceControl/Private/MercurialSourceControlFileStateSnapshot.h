@@ -0,0 +1,64 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+#include "MercurialSourceControlFileState.h"
+
+namespace MercurialSourceControl {
+
+class FFileStateCache;
+
+/**
+ * Saves the file state cache to disk when the editor shuts down and loads it back up on the 
+ * next startup, so the editor can display status icons before any hg commands have finished.
+ *
+ * A snapshot records the parents of the working directory it was taken against, and is discarded
+ * if they've changed by the time it's loaded (e.g. after a commit or an update outside of the 
+ * editor). Local modifications made while the editor wasn't running aren't detected, those 
+ * states are corrected by the status updates the editor requests anyway.
+ */
+class FFileStateSnapshot
+{
+public:
+	/** 
+	 * Save the states of all files within the given repository to the snapshot file.
+	 * @param InRepositoryRoot Absolute path to the root of the repository, must end in a '/'.
+	 */
+	static bool Save(const FString& InRepositoryRoot, const FFileStateCache& InFileStateCache);
+
+	/**
+	 * Load the states stored in the snapshot file, if it's still valid.
+	 * @param OutFileStates Will be filled in with the states stored in the snapshot.
+	 * @return false if there's no snapshot file, or it doesn't match the repository.
+	 */
+	static bool Load(TArray<FFileState>& OutFileStates);
+
+	/** Delete the snapshot file. */
+	static void Delete();
+
+private:
+	static FString GetFilename();
+};
+
+} // namespace MercurialSourceControl
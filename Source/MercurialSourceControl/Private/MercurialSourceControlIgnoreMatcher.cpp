@@ -0,0 +1,622 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlIgnoreMatcher.h"
+#include "Internationalization/Regex.h"
+
+namespace MercurialSourceControl {
+
+namespace 
+{
+	/** Include files that are nested deeper than this are assumed to include each other. */
+	const int32 MaxIncludeDepth = 16;
+
+	/** Brace expressions that expand to more than this many patterns are left as they are. */
+	const int32 MaxBraceExpansions = 256;
+
+	/** Get the kind of pattern the given syntax name or prefix (e.g. glob) corresponds to. */
+	bool GetPatternKind(const FString& InName, FString& OutKind)
+	{
+		// patterns in ignore files are relative by default, as in hg
+		static const TCHAR* Names[][2] = {
+			{ TEXT("re"), TEXT("relre") },
+			{ TEXT("regexp"), TEXT("relre") },
+			{ TEXT("relre"), TEXT("relre") },
+			{ TEXT("glob"), TEXT("relglob") },
+			{ TEXT("relglob"), TEXT("relglob") },
+			{ TEXT("rootglob"), TEXT("rootglob") },
+			{ TEXT("path"), TEXT("path") },
+			{ TEXT("relpath"), TEXT("path") },
+			{ TEXT("rootfilesin"), TEXT("rootfilesin") },
+			{ TEXT("include"), TEXT("include") },
+			{ TEXT("subinclude"), TEXT("subinclude") },
+		};
+		for (const auto& Name : Names)
+		{
+			if (InName.Equals(Name[0], ESearchCase::CaseSensitive))
+			{
+				OutKind = Name[1];
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/** Expand a leading ~ to the user's home directory, the way hg does for included files. */
+	FString ExpandPath(const FString& InPath)
+	{
+		if (!InPath.StartsWith(TEXT("~/")) && (InPath != TEXT("~")))
+		{
+			return InPath;
+		}
+		FString HomeDirectory = FPlatformMisc::GetEnvironmentVariable(TEXT("HOME"));
+		if (HomeDirectory.IsEmpty())
+		{
+			HomeDirectory = FPlatformMisc::GetEnvironmentVariable(TEXT("USERPROFILE"));
+		}
+		FString Path = HomeDirectory + InPath.RightChop(1);
+		FPaths::NormalizeFilename(Path);
+		return Path;
+	}
+
+	bool IsGlobSpecialChar(TCHAR C)
+	{
+		return (C == TEXT('*')) || (C == TEXT('?')) || (C == TEXT('[')) || (C == TEXT('{'))
+			|| (C == TEXT('\\'));
+	}
+
+	/** Escape all the characters in the given path that have a special meaning in a glob. */
+	FString EscapeGlob(const FString& InPath)
+	{
+		FString Glob;
+		Glob.Reserve(InPath.Len());
+		for (const TCHAR C : InPath)
+		{
+			if (IsGlobSpecialChar(C))
+			{
+				Glob += TEXT('\\');
+			}
+			Glob += C;
+		}
+		return Glob;
+	}
+
+	/** 
+	 * Expand the first brace expression in the given glob, and then any in the expansions, 
+	 * e.g. *.{sdf,suo} expands to *.sdf and *.suo
+	 */
+	void ExpandBraces(const FString& InGlob, TArray<FString>& OutGlobs)
+	{
+		int32 Start = INDEX_NONE;
+		int32 Depth = 0;
+		TArray<int32> Separators;
+		for (int32 i = 0; i < InGlob.Len(); ++i)
+		{
+			const TCHAR C = InGlob[i];
+			if (C == TEXT('\\'))
+			{
+				++i;
+			}
+			else if (C == TEXT('{'))
+			{
+				if (Depth++ == 0)
+				{
+					Start = i;
+				}
+			}
+			else if ((C == TEXT(',')) && (Depth == 1))
+			{
+				Separators.Add(i);
+			}
+			else if ((C == TEXT('}')) && (Depth > 0) && (--Depth == 0))
+			{
+				// like hg, braces that don't contain any alternatives are just braces
+				if ((Separators.Num() > 0) && (OutGlobs.Num() < MaxBraceExpansions))
+				{
+					const FString Prefix = InGlob.Left(Start);
+					const FString Suffix = InGlob.RightChop(i + 1);
+					Separators.Add(i);
+					int32 AlternativeStart = Start + 1;
+					for (const int32 Separator : Separators)
+					{
+						ExpandBraces(
+							Prefix + InGlob.Mid(AlternativeStart, Separator - AlternativeStart) + 
+							Suffix, OutGlobs
+						);
+						AlternativeStart = Separator + 1;
+					}
+					return;
+				}
+				Separators.Reset();
+			}
+		}
+		OutGlobs.Add(InGlob);
+	}
+
+	/** 
+	 * Find the closing bracket of the character class that starts at the given position.
+	 * @return The closing bracket, or nullptr if the class isn't terminated.
+	 */
+	const TCHAR* FindClassEnd(const TCHAR* InClassStart)
+	{
+		const TCHAR* End = InClassStart + 1;
+		if (*End == TEXT('!'))
+		{
+			++End;
+		}
+		// a bracket right at the start is part of the class
+		if (*End == TEXT(']'))
+		{
+			++End;
+		}
+		while (*End && (*End != TEXT(']')))
+		{
+			++End;
+		}
+		return *End ? End : nullptr;
+	}
+
+	/** Check if a character is in the class between the brackets at the given positions. */
+	bool MatchClass(const TCHAR* InClassStart, const TCHAR* InClassEnd, TCHAR C)
+	{
+		const TCHAR* Current = InClassStart + 1;
+		const bool bNegated = (*Current == TEXT('!'));
+		if (bNegated)
+		{
+			++Current;
+		}
+		bool bMatched = false;
+		while (Current < InClassEnd)
+		{
+			if ((Current + 2 < InClassEnd) && (Current[1] == TEXT('-')))
+			{
+				bMatched |= (Current[0] <= C) && (C <= Current[2]);
+				Current += 3;
+			}
+			else
+			{
+				bMatched |= (*Current == C);
+				++Current;
+			}
+		}
+		return bMatched != bNegated;
+	}
+
+	/** 
+	 * Match a glob (with braces already expanded) against a path, the glob must match the 
+	 * whole path, or the whole of one of the directories containing the path.
+	 * As in hg * and ? don't match '/', but ** does.
+	 */
+	bool MatchGlob(const TCHAR* InGlob, const TCHAR* InPath)
+	{
+		const TCHAR* Glob = InGlob;
+		const TCHAR* Path = InPath;
+		for (;;)
+		{
+			switch (*Glob)
+			{
+				case TEXT('\0'):
+					return (*Path == TEXT('\0')) || (*Path == TEXT('/'));
+
+				case TEXT('*'):
+					if (Glob[1] == TEXT('*'))
+					{
+						const TCHAR* Rest = Glob + 2;
+						// **/ may also match nothing at all, e.g. **/Saved matches Saved
+						if ((*Rest == TEXT('/')) && MatchGlob(Rest + 1, Path))
+						{
+							return true;
+						}
+						for (const TCHAR* Tail = Path; ; ++Tail)
+						{
+							if (MatchGlob(Rest, Tail))
+							{
+								return true;
+							}
+							if (*Tail == TEXT('\0'))
+							{
+								return false;
+							}
+						}
+					}
+					for (const TCHAR* Tail = Path; ; ++Tail)
+					{
+						if (MatchGlob(Glob + 1, Tail))
+						{
+							return true;
+						}
+						if ((*Tail == TEXT('\0')) || (*Tail == TEXT('/')))
+						{
+							return false;
+						}
+					}
+
+				case TEXT('?'):
+					if ((*Path == TEXT('\0')) || (*Path == TEXT('/')))
+					{
+						return false;
+					}
+					++Glob;
+					++Path;
+					break;
+
+				case TEXT('['):
+				{
+					const TCHAR* ClassEnd = FindClassEnd(Glob);
+					if (ClassEnd)
+					{
+						if ((*Path == TEXT('\0')) || !MatchClass(Glob, ClassEnd, *Path))
+						{
+							return false;
+						}
+						Glob = ClassEnd + 1;
+						++Path;
+						break;
+					}
+					// an unterminated class is just a bracket
+					if (*Path != TEXT('['))
+					{
+						return false;
+					}
+					++Glob;
+					++Path;
+					break;
+				}
+
+				default:
+					// a backslash escapes the next character
+					if ((*Glob == TEXT('\\')) && (Glob[1] != TEXT('\0')))
+					{
+						++Glob;
+					}
+					if (*Glob != *Path)
+					{
+						return false;
+					}
+					++Glob;
+					++Path;
+					break;
+			}
+		}
+	}
+
+	/** Match a glob against a path, starting at the beginning of any path segment. */
+	bool MatchGlobAtAnyDepth(const TCHAR* InGlob, const TCHAR* InPath)
+	{
+		for (const TCHAR* Segment = InPath; ; ++Segment)
+		{
+			if (MatchGlob(InGlob, Segment))
+			{
+				return true;
+			}
+			Segment = FCString::Strchr(Segment, TEXT('/'));
+			if (!Segment)
+			{
+				return false;
+			}
+		}
+	}
+} // unnamed namespace
+
+FIgnoreMatcher::FSourceFile FIgnoreMatcher::FSourceFile::FromFile(const FString& InFilename)
+{
+	FSourceFile SourceFile;
+	SourceFile.Filename = InFilename;
+	SourceFile.Size = -1;
+	const FFileStatData StatData = IFileManager::Get().GetStatData(*InFilename);
+	if (StatData.bIsValid && !StatData.bIsDirectory)
+	{
+		SourceFile.Size = StatData.FileSize;
+		SourceFile.TimeStamp = StatData.ModificationTime;
+	}
+	return SourceFile;
+}
+
+FIgnoreMatcherPtr FIgnoreMatcher::Compile(
+	const FString& InRepositoryRoot, const TArray<FString>& InIgnoreFiles
+)
+{
+	FIgnoreMatcherPtr Matcher = MakeShareable(new FIgnoreMatcher());
+	Matcher->RepositoryRoot = InRepositoryRoot;
+
+	// the repository's config is the most likely place for the ui.ignore settings to change
+	Matcher->SourceFiles.Add(FSourceFile::FromFile(InRepositoryRoot + TEXT(".hg/hgrc")));
+
+	Matcher->AddPatternFile(InRepositoryRoot + TEXT(".hgignore"), FString(), 0);
+	for (const FString& IgnoreFile : InIgnoreFiles)
+	{
+		FString Filename = ExpandPath(IgnoreFile);
+		FPaths::NormalizeFilename(Filename);
+		if (FPaths::IsRelative(Filename))
+		{
+			Filename = InRepositoryRoot / Filename;
+		}
+		Matcher->AddPatternFile(Filename, FString(), 0);
+	}
+
+	// all the expressions for a root are combined into one, so a path only needs to be 
+	// matched once per root, which is what hg does too
+	for (const auto& Pair : Matcher->RegexSources)
+	{
+		FRegex Regex;
+		Regex.Root = Pair.Key;
+		Regex.Pattern = MakeShareable(
+			new FRegexPattern(TEXT("(?:") + FString::Join(Pair.Value, TEXT(")|(?:")) + TEXT(")"))
+		);
+		Matcher->Regexes.Add(Regex);
+	}
+	Matcher->RegexSources.Empty();
+	return Matcher;
+}
+
+bool FIgnoreMatcher::IsOutOfDate() const
+{
+	for (const FSourceFile& SourceFile : SourceFiles)
+	{
+		const FSourceFile CurrentFile = FSourceFile::FromFile(SourceFile.Filename);
+		if ((CurrentFile.Size != SourceFile.Size) || 
+			(CurrentFile.TimeStamp != SourceFile.TimeStamp))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FIgnoreMatcher::IsIgnored(const FString& InRelativePath) const
+{
+	if (Matches(InRelativePath))
+	{
+		return true;
+	}
+	// everything in an ignored directory is ignored too
+	for (int32 i = InRelativePath.Len() - 1; i > 0; --i)
+	{
+		if ((InRelativePath[i] == TEXT('/')) && Matches(InRelativePath.Left(i)))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FIgnoreMatcher::Matches(const FString& InRelativePath) const
+{
+	if (IgnoredNames.Num() > 0)
+	{
+		int32 SegmentStart = 0;
+		for (int32 i = 0; i <= InRelativePath.Len(); ++i)
+		{
+			if ((i == InRelativePath.Len()) || (InRelativePath[i] == TEXT('/')))
+			{
+				if ((i > SegmentStart) && 
+					IgnoredNames.Contains(InRelativePath.Mid(SegmentStart, i - SegmentStart)))
+				{
+					return true;
+				}
+				SegmentStart = i + 1;
+			}
+		}
+	}
+
+	for (const FGlob& Glob : Globs)
+	{
+		if (!Glob.Root.IsEmpty() && 
+			!InRelativePath.StartsWith(Glob.Root, ESearchCase::CaseSensitive))
+		{
+			continue;
+		}
+		const TCHAR* Path = *InRelativePath + Glob.Root.Len();
+		const bool bMatched = Glob.bIsRooted ? 
+			MatchGlob(*Glob.Pattern, Path) : MatchGlobAtAnyDepth(*Glob.Pattern, Path);
+		if (bMatched)
+		{
+			return true;
+		}
+	}
+
+	for (const FRegex& Regex : Regexes)
+	{
+		if (!Regex.Root.IsEmpty() && 
+			!InRelativePath.StartsWith(Regex.Root, ESearchCase::CaseSensitive))
+		{
+			continue;
+		}
+		FRegexMatcher Matcher(*Regex.Pattern, InRelativePath.RightChop(Regex.Root.Len()));
+		if (Matcher.FindNext())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void FIgnoreMatcher::AddPatternFile(const FString& InFilename, const FString& InRoot, int32 InDepth)
+{
+	SourceFiles.Add(FSourceFile::FromFile(InFilename));
+	if (InDepth > MaxIncludeDepth)
+	{
+		Invalidate(InFilename, TEXT("includes are nested too deeply"));
+		return;
+	}
+
+	FString Contents;
+	if (!FPaths::FileExists(InFilename) || !FFileHelper::LoadFileToString(Contents, *InFilename))
+	{
+		// hg doesn't mind if ignore files don't exist
+		return;
+	}
+
+	// patterns are regular expressions until a syntax line says otherwise
+	FString Syntax(TEXT("relre"));
+	TArray<FString> Lines;
+	Contents.ParseIntoArrayLines(Lines, false);
+	for (FString& Line : Lines)
+	{
+		// everything after a # is a comment, unless it's escaped
+		for (int32 i = 0; i < Line.Len(); ++i)
+		{
+			if (Line[i] == TEXT('#'))
+			{
+				if ((i > 0) && (Line[i - 1] == TEXT('\\')))
+				{
+					Line.RemoveAt(--i);
+				}
+				else
+				{
+					Line = Line.Left(i);
+					break;
+				}
+			}
+		}
+		Line.TrimEndInline();
+		if (Line.IsEmpty())
+		{
+			continue;
+		}
+
+		if (Line.StartsWith(TEXT("syntax:"), ESearchCase::CaseSensitive))
+		{
+			const FString Name = Line.RightChop(7).TrimStartAndEnd();
+			if (!GetPatternKind(Name, Syntax))
+			{
+				Invalidate(InFilename, FString::Printf(TEXT("unknown syntax '%s'"), *Name));
+			}
+			continue;
+		}
+
+		// a pattern may override the syntax with a prefix, e.g. glob:*.sdf
+		FString Kind = Syntax;
+		FString Pattern = Line;
+		int32 ColonIndex = INDEX_NONE;
+		if (Line.FindChar(TEXT(':'), ColonIndex) && GetPatternKind(Line.Left(ColonIndex), Kind))
+		{
+			Pattern = Line.RightChop(ColonIndex + 1);
+		}
+		AddPattern(Kind, Pattern, InFilename, InRoot, InDepth);
+	}
+}
+
+void FIgnoreMatcher::AddPattern(
+	const FString& InKind, const FString& InPattern, const FString& InFilename, 
+	const FString& InRoot, int32 InDepth
+)
+{
+	if ((InKind == TEXT("relglob")) || (InKind == TEXT("rootglob")))
+	{
+		const bool bIsRooted = (InKind == TEXT("rootglob"));
+		TArray<FString> Patterns;
+		ExpandBraces(InPattern, Patterns);
+		for (FString& Pattern : Patterns)
+		{
+			bool bIsName = !bIsRooted && InRoot.IsEmpty();
+			for (const TCHAR C : Pattern)
+			{
+				bIsName &= !IsGlobSpecialChar(C) && (C != TEXT('/'));
+			}
+			if (bIsName)
+			{
+				IgnoredNames.Add(Pattern);
+			}
+			else
+			{
+				Globs.Add({ MoveTemp(Pattern), InRoot, bIsRooted });
+			}
+		}
+	}
+	else if (InKind == TEXT("relre"))
+	{
+		// Python's named groups are the only common syntax ICU doesn't understand
+		if (InPattern.Contains(TEXT("(?P"), ESearchCase::CaseSensitive))
+		{
+			Invalidate(InFilename, FString::Printf(TEXT("unsupported regexp '%s'"), *InPattern));
+			return;
+		}
+		RegexSources.FindOrAdd(InRoot).Add(InPattern);
+	}
+	else if ((InKind == TEXT("path")) || (InKind == TEXT("rootfilesin")))
+	{
+		FString Path = InPattern;
+		FPaths::NormalizeFilename(Path);
+		Path.RemoveFromEnd(TEXT("/"));
+		if (Path == TEXT("."))
+		{
+			Path.Empty();
+		}
+		FString Pattern = EscapeGlob(Path);
+		if (InKind == TEXT("rootfilesin"))
+		{
+			Pattern += Path.IsEmpty() ? TEXT("*") : TEXT("/*");
+		}
+		else if (Path.IsEmpty())
+		{
+			Pattern = TEXT("**");
+		}
+		Globs.Add({ Pattern, InRoot, true });
+	}
+	else if ((InKind == TEXT("include")) || (InKind == TEXT("subinclude")))
+	{
+		// included files are relative to the file that includes them
+		FString Filename = ExpandPath(InPattern);
+		FPaths::NormalizeFilename(Filename);
+		if (FPaths::IsRelative(Filename))
+		{
+			Filename = FPaths::GetPath(InFilename) / Filename;
+		}
+		FPaths::CollapseRelativeDirectories(Filename);
+
+		if (InKind == TEXT("include"))
+		{
+			AddPatternFile(Filename, InRoot, InDepth + 1);
+			return;
+		}
+
+		// the patterns in a subinclude only apply to the directory the file is in
+		FString Root = FPaths::GetPath(Filename) + TEXT("/");
+		if (!Root.StartsWith(RepositoryRoot))
+		{
+			Invalidate(
+				InFilename, FString::Printf(TEXT("'%s' is outside the repository"), *InPattern)
+			);
+			return;
+		}
+		AddPatternFile(Filename, Root.RightChop(RepositoryRoot.Len()), InDepth + 1);
+	}
+	else
+	{
+		Invalidate(InFilename, FString::Printf(TEXT("unsupported pattern '%s'"), *InPattern));
+	}
+}
+
+void FIgnoreMatcher::Invalidate(const FString& InFilename, const FString& InReason)
+{
+	UE_LOG(
+		LogSourceControl, Log, TEXT("%s: %s, hg will be asked which files are ignored."), 
+		*InFilename, *InReason
+	);
+	bIsValid = false;
+}
+
+} // namespace MercurialSourceControl
@@ -0,0 +1,166 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+class FRegexPattern;
+
+namespace MercurialSourceControl {
+
+typedef TSharedPtr<class FIgnoreMatcher, ESPMode::ThreadSafe> FIgnoreMatcherPtr;
+
+/**
+ * Decides whether untracked files in a repository are ignored without invoking hg, by compiling 
+ * the same ignore rules hg uses: the .hgignore file in the root of the repository, any files 
+ * listed in the ui.ignore settings, and any files included by those.
+ *
+ * Glob patterns are matched natively, regular expressions are matched with ICU, which accepts 
+ * the same syntax as Python for all but the most exotic expressions. If the rules use anything 
+ * the matcher doesn't understand (e.g. filesets) the matcher is invalid, and hg should be asked 
+ * instead.
+ *
+ * Once compiled a matcher is never modified, so it's safe to use from any thread.
+ */
+class FIgnoreMatcher
+{
+public:
+	/** 
+	 * Compile the ignore rules of the given repository.
+	 * @param InRepositoryRoot Absolute path to the root of the repository, must end in a '/'.
+	 * @param InIgnoreFiles The files listed in the ui.ignore settings, relative filenames are 
+	 *                      relative to the repository root.
+	 * @return A matcher, which may not be valid, but will know when it needs to be recompiled.
+	 */
+	static FIgnoreMatcherPtr Compile(
+		const FString& InRepositoryRoot, const TArray<FString>& InIgnoreFiles
+	);
+
+	/** Check if the matcher understood all the rules it was compiled from. */
+	bool IsValid() const
+	{
+		return bIsValid;
+	}
+
+	const FString& GetRepositoryRoot() const
+	{
+		return RepositoryRoot;
+	}
+
+	/** 
+	 * Check if any of the files the matcher was compiled from (including the repository's 
+	 * config, which may change the ui.ignore settings) have changed since it was compiled.
+	 */
+	bool IsOutOfDate() const;
+
+	/** 
+	 * Check if the given path, or any of the directories containing it, is ignored.
+	 * @param InRelativePath Path relative to the root of the repository, with '/' separators.
+	 */
+	bool IsIgnored(const FString& InRelativePath) const;
+
+	/** 
+	 * Check if the given path is ignored, without checking the directories containing it.
+	 * This is only meant to be used while walking down from a directory that isn't ignored.
+	 */
+	bool Matches(const FString& InRelativePath) const;
+
+private:
+	/** A glob pattern, only applies to paths within its root directory. */
+	struct FGlob
+	{
+		FString Pattern;
+		/** Empty, or a path relative to the repository root that ends in a '/'. */
+		FString Root;
+		/** If false the pattern may match at any depth below the root. */
+		bool bIsRooted;
+	};
+
+	/** All the regular expressions that apply to paths within a particular root directory. */
+	struct FRegex
+	{
+		FString Root;
+		TSharedPtr<FRegexPattern> Pattern;
+	};
+
+	/** The size and timestamp of a file (which may not exist) the matcher was compiled from. */
+	struct FSourceFile
+	{
+		FString Filename;
+		int64 Size;
+		FDateTime TimeStamp;
+
+		static FSourceFile FromFile(const FString& InFilename);
+	};
+
+	/** Case-sensitive, like hg, unlike the default key functions for FString. */
+	struct FCaseSensitiveKeyFuncs : BaseKeyFuncs<FString, FString>
+	{
+		static const FString& GetSetKey(const FString& Element)
+		{
+			return Element;
+		}
+
+		static bool Matches(const FString& A, const FString& B)
+		{
+			return A.Equals(B, ESearchCase::CaseSensitive);
+		}
+
+		static uint32 GetKeyHash(const FString& Key)
+		{
+			return FCrc::StrCrc32(*Key);
+		}
+	};
+
+private:
+	FIgnoreMatcher() : bIsValid(true) {}
+
+	/** 
+	 * Add the patterns in the given file.
+	 * @param InRoot Directory the patterns apply to, relative to the repository root.
+	 */
+	void AddPatternFile(const FString& InFilename, const FString& InRoot, int32 InDepth);
+
+	/** Add a single pattern from the given file, of the given kind (e.g. relglob). */
+	void AddPattern(
+		const FString& InKind, const FString& InPattern, const FString& InFilename, 
+		const FString& InRoot, int32 InDepth
+	);
+
+	/** Mark the matcher as invalid, and say why in the log. */
+	void Invalidate(const FString& InFilename, const FString& InReason);
+
+private:
+	FString RepositoryRoot;
+	bool bIsValid;
+
+	/** Names that are ignored wherever they appear in a path (e.g. Intermediate). */
+	TSet<FString, FCaseSensitiveKeyFuncs> IgnoredNames;
+	TArray<FGlob> Globs;
+	/** Regular expression sources keyed by root, combined into Regexes once compiled. */
+	TMap<FString, TArray<FString>> RegexSources;
+	TArray<FRegex> Regexes;
+
+	TArray<FSourceFile> SourceFiles;
+};
+
+} // namespace MercurialSourceControl
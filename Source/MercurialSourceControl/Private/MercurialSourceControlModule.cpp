@@ -28,6 +28,9 @@
 #include "MercurialSourceControlOperationNames.h"
 #include "MercurialSourceControlWorkers.h"
 #include "MercurialSourceControlStyle.h"
+#include "MercurialSourceControlClient.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/Async.h"
 
 namespace MercurialSourceControl {
 
@@ -38,6 +41,44 @@ namespace
 	{
 		return MakeShareable(new T());
 	}	
+
+	/** 
+	 * Log how much each enabled Mercurial extension adds to the startup time of hg.
+	 * The optional argument is the number of times each measurement should be taken.
+	 */
+	void MeasureExtensionCosts(const TArray<FString>& InArgs)
+	{
+		const FClientSharedPtr Client = FClient::Get();
+		if (!Client.IsValid())
+		{
+			UE_LOG(LogSourceControl, Warning, TEXT("Mercurial source control isn't connected."));
+			return;
+		}
+
+		const FString RepositoryRoot = FModule::GetProvider().GetWorkingDirectory();
+		const int32 NumSamples = (InArgs.Num() > 0) ? FCString::Atoi(*InArgs[0]) : 5;
+		UE_LOG(LogSourceControl, Display, TEXT("Measuring the cost of Mercurial extensions..."));
+
+		// this spawns a lot of processes, so keep it off the game thread
+		Async<void>(EAsyncExecution::ThreadPool, [Client, RepositoryRoot, NumSamples]()
+		{
+			double Baseline = 0.0;
+			TArray<TPair<FString, double> > Costs;
+			Client->MeasureExtensionCosts(RepositoryRoot, NumSamples, Baseline, Costs);
+
+			UE_LOG(
+				LogSourceControl, Display, TEXT("hg startup with no extensions: %.1f ms"), 
+				Baseline * 1000.0
+			);
+			for (const auto& Cost : Costs)
+			{
+				UE_LOG(
+					LogSourceControl, Display, TEXT("  %s: %+.1f ms"), *Cost.Key, 
+					Cost.Value * 1000.0
+				);
+			}
+		});
+	}
 } // unnamed namespace
 
 void FModule::StartupModule()
@@ -70,10 +111,23 @@ void FModule::StartupModule()
 	);
 	
 	IModularFeatures::Get().RegisterModularFeature(FeatureName, &Provider);
+
+	MeasureExtensionCostsCommand = IConsoleManager::Get().RegisterConsoleCommand(
+		TEXT("Mercurial.MeasureExtensionCosts"),
+		TEXT("Log how much each enabled Mercurial extension adds to the startup time of hg. ")
+		TEXT("Optionally takes the number of samples to take for each extension."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&MeasureExtensionCosts)
+	);
 }
 
 void FModule::ShutdownModule()
 {
+	if (MeasureExtensionCostsCommand)
+	{
+		IConsoleManager::Get().UnregisterConsoleObject(MeasureExtensionCostsCommand);
+		MeasureExtensionCostsCommand = nullptr;
+	}
+
 	Provider.Close();
 	IModularFeatures::Get().UnregisterModularFeature(FeatureName, &Provider);
 	FMercurialStyle::Shutdown();
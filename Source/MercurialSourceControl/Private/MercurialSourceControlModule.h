@@ -36,13 +36,14 @@ public:
 	virtual bool IsGameModule() const;
 
 public:
-	FModule() : FeatureName("SourceControl") {}
+	FModule() : FeatureName("SourceControl"), MeasureExtensionCostsCommand(nullptr) {}
 
 	static FProvider& GetProvider();
 
 private:
 	FProvider Provider;
 	FName FeatureName;
+	IConsoleObject* MeasureExtensionCostsCommand;
 };
 
 } // namespace MercurialSourceControl
@@ -0,0 +1,133 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlMutationJournal.h"
+
+namespace MercurialSourceControl {
+
+bool FMutationJournal::CanRecord(FPathId InPathId, EJournalIntent InIntent) const
+{
+	const FEntry* OldEntry = Intents.Find(InPathId);
+	TOptional<EJournalIntent> MergedIntent;
+	return !OldEntry || Merge(OldEntry->Intent, InIntent, MergedIntent);
+}
+
+void FMutationJournal::Record(FPathId InPathId, EJournalIntent InIntent, int32 InOwner)
+{
+	FEntry* OldEntry = Intents.Find(InPathId);
+	if (!OldEntry)
+	{
+		FEntry& Entry = Intents.Add(InPathId);
+		Entry.Intent = InIntent;
+		Entry.Owners.Add(InOwner);
+		return;
+	}
+
+	TOptional<EJournalIntent> MergedIntent;
+	verify(Merge(OldEntry->Intent, InIntent, MergedIntent));
+	if (MergedIntent.IsSet())
+	{
+		OldEntry->Intent = MergedIntent.GetValue();
+		OldEntry->Owners.AddUnique(InOwner);
+	}
+	else
+	{
+		Intents.Remove(InPathId);
+	}
+}
+
+void FMutationJournal::Flush(
+	FJournalBatch& OutAdd, FJournalBatch& OutLargeAdd, FJournalBatch& OutRemove, 
+	FJournalBatch& OutRevert
+)
+{
+	FPathTable& PathTable = FPathTable::Get();
+	for (auto It(Intents.CreateConstIterator()); It; ++It)
+	{
+		FJournalBatch* Batch = nullptr;
+		switch (It.Value().Intent)
+		{
+			case EJournalIntent::Add:
+				Batch = &OutAdd;
+				break;
+
+			case EJournalIntent::AddLarge:
+				Batch = &OutLargeAdd;
+				break;
+
+			case EJournalIntent::Remove:
+				Batch = &OutRemove;
+				break;
+
+			case EJournalIntent::Revert:
+				Batch = &OutRevert;
+				break;
+		}
+		if (Batch)
+		{
+			Batch->Files.Add(PathTable.GetPath(It.Key()));
+			Batch->Owners.Append(It.Value().Owners);
+		}
+	}
+	Intents.Reset();
+}
+
+bool FMutationJournal::Merge(
+	EJournalIntent InOldIntent, EJournalIntent InNewIntent, TOptional<EJournalIntent>& OutIntent
+)
+{
+	OutIntent.Reset();
+
+	if (InOldIntent == InNewIntent)
+	{
+		OutIntent = InNewIntent;
+		return true;
+	}
+
+	switch (InOldIntent)
+	{
+		case EJournalIntent::Add:
+		case EJournalIntent::AddLarge:
+			// deleting or reverting a file that hasn't actually been added yet leaves it untracked,
+			// re-adding it with a different flag has to wait for the first add though
+			return (InNewIntent == EJournalIntent::Remove) || (InNewIntent == EJournalIntent::Revert);
+
+		case EJournalIntent::Remove:
+			if (InNewIntent == EJournalIntent::Revert)
+			{
+				// reverting restores the file whether or not it was removed first
+				OutIntent = EJournalIntent::Revert;
+			}
+			// otherwise re-adding a file that hasn't actually been removed yet leaves it tracked
+			return true;
+
+		case EJournalIntent::Revert:
+			// anything else has to be applied on top of the revert
+			return false;
+	}
+	return false;
+}
+
+} // namespace MercurialSourceControl
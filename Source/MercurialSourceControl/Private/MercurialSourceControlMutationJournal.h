@@ -0,0 +1,106 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+#include "MercurialSourceControlPathTable.h"
+
+namespace MercurialSourceControl {
+
+/** Mutations that can be recorded in an FMutationJournal. */
+enum class EJournalIntent : uint8
+{
+	Add,
+	/** Add flagged as a large file. */
+	AddLarge,
+	Remove,
+	Revert,
+};
+
+/** Files that flushed intents of one kind apply to. */
+struct FJournalBatch
+{
+	TArray<FString> Files;
+	/** Owners (as passed to FMutationJournal::Record()) of the intents for Files. */
+	TSet<int32> Owners;
+};
+
+/**
+ * Records mutations requested by the editor so that they can be applied later with as few 
+ * hg invocations as possible.
+ *
+ * Only one intent is kept per file, a new intent is merged with the pending intent where the 
+ * outcome is well defined (e.g. adding a file and then deleting it cancels out), otherwise 
+ * the journal must be flushed before the new intent can be recorded. Each intent remembers 
+ * who recorded it (and any intents merged into it), an owner whose intents all cancel out 
+ * won't be part of any batch when the journal is flushed.
+ *
+ * @note Not thread-safe, only meant to be used on the main thread.
+ */
+class FMutationJournal
+{
+public:
+	/** Check if the given intent can be recorded without flushing the journal first. */
+	bool CanRecord(FPathId InPathId, EJournalIntent InIntent) const;
+
+	/** 
+	 * Record an intent, merging it with any intent already recorded for the same file.
+	 * @param InOwner Identifies whoever recorded the intent, e.g. an index into an array.
+	 * @note CanRecord() must be true for the given intent.
+	 */
+	void Record(FPathId InPathId, EJournalIntent InIntent, int32 InOwner);
+
+	bool IsEmpty() const
+	{
+		return Intents.Num() == 0;
+	}
+
+	/** 
+	 * Remove all the recorded intents from the journal. 
+	 * Each file will end up in at most one of the output batches.
+	 */
+	void Flush(
+		FJournalBatch& OutAdd, FJournalBatch& OutLargeAdd, FJournalBatch& OutRemove, 
+		FJournalBatch& OutRevert
+	);
+
+private:
+	/**
+	 * Merge two intents for the same file.
+	 * @param OutIntent Will be set to the merged intent, or unset if the intents cancel out.
+	 * @return false if the intents can't be merged.
+	 */
+	static bool Merge(EJournalIntent InOldIntent, EJournalIntent InNewIntent, TOptional<EJournalIntent>& OutIntent);
+
+private:
+	struct FEntry
+	{
+		EJournalIntent Intent;
+		/** Owners of all the intents that were merged into this one. */
+		TArray<int32, TInlineAllocator<1>> Owners;
+	};
+
+	TMap<FPathId, FEntry> Intents;
+};
+
+} // namespace MercurialSourceControl
@@ -0,0 +1,199 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlPathNormalizer.h"
+
+namespace MercurialSourceControl {
+
+namespace 
+{
+	/** The cache is cleared when it grows beyond this many entries. */
+	const int32 MaxCachedFilenames = 64 * 1024;
+
+	void AddTrailingSlash(FString& InOutPath)
+	{
+		if (!InOutPath.EndsWith(TEXT("/")))
+		{
+			InOutPath += TEXT("/");
+		}
+	}
+} // unnamed namespace
+
+void FPathNormalizer::Initialize()
+{
+	check(IsInGameThread());
+
+	Prefixes.Reset();
+	const FString RelativeDirs[] = 
+	{
+		FPaths::ProjectContentDir(),
+		FPaths::ProjectDir(),
+		FPaths::EngineContentDir(),
+	};
+	for (const FString& RelativeDir : RelativeDirs)
+	{
+		FPrefix Prefix;
+		Prefix.Relative = RelativeDir;
+		FPaths::NormalizeDirectoryName(Prefix.Relative);
+		AddTrailingSlash(Prefix.Relative);
+		Prefix.Absolute = FPaths::ConvertRelativePathToFull(Prefix.Relative);
+		AddTrailingSlash(Prefix.Absolute);
+		Prefixes.Add(Prefix);
+	}
+
+	FRWScopeLock WriteLock(CacheLock, SLT_Write);
+	AbsoluteFilenameCache.Empty();
+}
+
+FString FPathNormalizer::ToAbsolute(const FString& InFilename) const
+{
+	if (IsNormalizedAbsolute(InFilename))
+	{
+		return InFilename;
+	}
+
+	for (const FPrefix& Prefix : Prefixes)
+	{
+		if (InFilename.StartsWith(Prefix.Relative, ESearchCase::CaseSensitive)
+			&& IsNormalizedRelative(*InFilename + Prefix.Relative.Len()))
+		{
+			FString AbsoluteFilename;
+			AbsoluteFilename.Reserve(Prefix.Absolute.Len() + InFilename.Len() - Prefix.Relative.Len());
+			AbsoluteFilename += Prefix.Absolute;
+			AbsoluteFilename += *InFilename + Prefix.Relative.Len();
+			return AbsoluteFilename;
+		}
+	}
+
+	{
+		FRWScopeLock ReadLock(CacheLock, SLT_ReadOnly);
+		const FString* CachedFilename = AbsoluteFilenameCache.Find(InFilename);
+		if (CachedFilename)
+		{
+			return *CachedFilename;
+		}
+	}
+
+	FString AbsoluteFilename = FPaths::ConvertRelativePathToFull(InFilename);
+	FRWScopeLock WriteLock(CacheLock, SLT_Write);
+	if (AbsoluteFilenameCache.Num() >= MaxCachedFilenames)
+	{
+		AbsoluteFilenameCache.Reset();
+	}
+	AbsoluteFilenameCache.Add(InFilename, AbsoluteFilename);
+	return AbsoluteFilename;
+}
+
+void FPathNormalizer::ToAbsolute(
+	const TArray<FString>& InFiles, TArray<FString>& OutAbsoluteFiles
+) const
+{
+	OutAbsoluteFiles.Reserve(OutAbsoluteFiles.Num() + InFiles.Num());
+	for (const auto& Filename : InFiles)
+	{
+		OutAbsoluteFiles.Add(ToAbsolute(Filename));
+	}
+}
+
+bool FPathNormalizer::ToRelative(
+	const FString& InRoot, const FString& InAbsoluteFilename, FString& OutRelativeFilename
+)
+{
+	// FPaths::MakePathRelativeTo() treats anything after the last slash in the root as a filename,
+	// so the fast path only applies to roots that end with a slash (which they normally do)
+	if (InRoot.EndsWith(TEXT("/"), ESearchCase::CaseSensitive)
+		&& InAbsoluteFilename.StartsWith(InRoot, ESearchCase::CaseSensitive))
+	{
+		OutRelativeFilename = InAbsoluteFilename.RightChop(InRoot.Len());
+		return true;
+	}
+
+	// the filename is outside the root, or differs from it in case
+	OutRelativeFilename = InAbsoluteFilename;
+	return FPaths::MakePathRelativeTo(OutRelativeFilename, *InRoot);
+}
+
+bool FPathNormalizer::ToRelative(
+	const FString& InRoot, const TArray<FString>& InFiles, TArray<FString>& OutFiles
+)
+{
+	OutFiles.Reserve(OutFiles.Num() + InFiles.Num());
+	for (const auto& AbsoluteFilename : InFiles)
+	{
+		FString RelativeFilename;
+		if (!ToRelative(InRoot, AbsoluteFilename, RelativeFilename))
+		{
+			return false;
+		}
+		OutFiles.Add(MoveTemp(RelativeFilename));
+	}
+	return true;
+}
+
+bool FPathNormalizer::IsNormalizedAbsolute(const FString& InFilename)
+{
+	if (FPaths::IsRelative(InFilename))
+	{
+		return false;
+	}
+	return IsNormalizedRelative(*InFilename);
+}
+
+bool FPathNormalizer::IsNormalizedRelative(const TCHAR* InFilename)
+{
+	// reject backslashes, duplicate slashes, and "." or ".." segments
+	const TCHAR* SegmentStart = InFilename;
+	for (const TCHAR* Char = InFilename; ; ++Char)
+	{
+		if (*Char == TEXT('\\'))
+		{
+			return false;
+		}
+
+		if ((*Char == TEXT('/')) || (*Char == TEXT('\0')))
+		{
+			const int32 SegmentLen = Char - SegmentStart;
+			if ((SegmentLen == 0) && (SegmentStart != InFilename) && (*Char != TEXT('\0')))
+			{
+				return false;
+			}
+			if ((SegmentLen == 1) && (SegmentStart[0] == TEXT('.')))
+			{
+				return false;
+			}
+			if ((SegmentLen == 2) && (SegmentStart[0] == TEXT('.')) && (SegmentStart[1] == TEXT('.')))
+			{
+				return false;
+			}
+			if (*Char == TEXT('\0'))
+			{
+				return true;
+			}
+			SegmentStart = Char + 1;
+		}
+	}
+}
+
+} // namespace MercurialSourceControl
@@ -0,0 +1,92 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+namespace MercurialSourceControl {
+
+/**
+ * Converts batches of filenames between the forms used by the editor and by hg.
+ *
+ * The editor usually passes in filenames relative to the engine binaries directory 
+ * (e.g. ../../../MyProject/Content/Foo.uasset), while hg wants filenames relative to the 
+ * repository root. Instead of running every filename through FPaths::ConvertRelativePathToFull()
+ * and FPaths::MakePathRelativeTo() (both of which build several temporary strings) the common 
+ * prefixes are computed once and simply swapped, the general purpose conversions are only used 
+ * for unusual filenames, and their results are cached.
+ *
+ * @note All methods are thread-safe.
+ */
+class FPathNormalizer
+{
+public:
+	/** 
+	 * Precompute the prefixes for the current project.
+	 * @note Must be called on the main thread before any conversions are done.
+	 */
+	void Initialize();
+
+	/** Convert the given filename to a normalized absolute filename. */
+	FString ToAbsolute(const FString& InFilename) const;
+
+	/** Convert the given filenames to normalized absolute filenames. */
+	void ToAbsolute(const TArray<FString>& InFiles, TArray<FString>& OutAbsoluteFiles) const;
+
+	/** 
+	 * Make the given absolute filename relative to the given absolute directory.
+	 * @return false if no relative path exists (e.g. the filename is on a different drive).
+	 */
+	static bool ToRelative(const FString& InRoot, const FString& InAbsoluteFilename, FString& OutRelativeFilename);
+
+	/** 
+	 * Make the given absolute filenames relative to the given absolute directory.
+	 * @return false if any of the filenames can't be made relative, in which case OutFiles 
+	 *         will only contain the filenames that were converted before the failure.
+	 */
+	static bool ToRelative(const FString& InRoot, const TArray<FString>& InFiles, TArray<FString>& OutFiles);
+
+private:
+	/** Check if the given filename is absolute and doesn't need any further normalization. */
+	static bool IsNormalizedAbsolute(const FString& InFilename);
+
+	/** Check if the given relative filename can be appended to an absolute path as is. */
+	static bool IsNormalizedRelative(const TCHAR* InFilename);
+
+private:
+	struct FPrefix
+	{
+		/** Prefix as the editor usually passes it in (relative to the base directory). */
+		FString Relative;
+		/** Normalized absolute equivalent of Relative. */
+		FString Absolute;
+	};
+
+	/** Relative to absolute prefix mappings, most specific first. */
+	TArray<FPrefix> Prefixes;
+
+	/** Results of previous general purpose conversions. */
+	mutable TMap<FString, FString> AbsoluteFilenameCache;
+	mutable FRWLock CacheLock;
+};
+
+} // namespace MercurialSourceControl
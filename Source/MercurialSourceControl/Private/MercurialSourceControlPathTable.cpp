@@ -0,0 +1,184 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlPathTable.h"
+
+namespace MercurialSourceControl {
+
+FPathTable& FPathTable::Get()
+{
+	static FPathTable Singleton;
+	return Singleton;
+}
+
+template<typename FunctionType>
+void FPathTable::ForEachSegment(const FString& InPath, FunctionType Function)
+{
+	const TCHAR* Path = *InPath;
+	const int32 PathLen = InPath.Len();
+	int32 SegmentStart = 0;
+	for (int32 i = 0; i <= PathLen; ++i)
+	{
+		if ((i == PathLen) || (Path[i] == TEXT('/')) || (Path[i] == TEXT('\\')))
+		{
+			// the first segment may be empty (the root of an absolute POSIX path), 
+			// empty segments after that are just redundant separators
+			const int32 SegmentLen = i - SegmentStart;
+			if ((SegmentLen > 0) || (SegmentStart == 0))
+			{
+				if (!Function(Path + SegmentStart, SegmentLen))
+				{
+					return;
+				}
+			}
+			SegmentStart = i + 1;
+		}
+	}
+}
+
+FPathId FPathTable::Intern(const FString& InPath)
+{
+	const bool bIsDirectory = InPath.EndsWith(TEXT("/")) || InPath.EndsWith(TEXT("\\"));
+	FPathId PathId = Find(InPath);
+	if (PathId != INDEX_NONE)
+	{
+		FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+		if (!bIsDirectory || Nodes[PathId].bIsDirectory)
+		{
+			return PathId;
+		}
+	}
+
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	PathId = INDEX_NONE;
+	ForEachSegment(InPath, [this, &PathId](const TCHAR* InSegment, int32 InSegmentLen)
+	{
+		const uint32 Hash = HashSegment(PathId, InSegment, InSegmentLen);
+		FPathId ChildId = FindChild(PathId, InSegment, InSegmentLen, Hash);
+		if (ChildId == INDEX_NONE)
+		{
+			FNode Node;
+			Node.ParentId = PathId;
+			Node.Segment = FString(InSegmentLen, InSegment);
+			Node.bIsDirectory = false;
+			ChildId = Nodes.AddElement(Node);
+			NodesByHash.Add(Hash, ChildId);
+		}
+		PathId = ChildId;
+		return true;
+	});
+	if (bIsDirectory)
+	{
+		Nodes[PathId].bIsDirectory = true;
+	}
+	return PathId;
+}
+
+FPathId FPathTable::Find(const FString& InPath) const
+{
+	FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+	FPathId PathId = INDEX_NONE;
+	bool bFound = true;
+	ForEachSegment(InPath, [this, &PathId, &bFound](const TCHAR* InSegment, int32 InSegmentLen)
+	{
+		PathId = FindChild(
+			PathId, InSegment, InSegmentLen, HashSegment(PathId, InSegment, InSegmentLen)
+		);
+		bFound = (PathId != INDEX_NONE);
+		return bFound;
+	});
+	return bFound ? PathId : INDEX_NONE;
+}
+
+FPathId FPathTable::GetParent(FPathId InPathId) const
+{
+	FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+	return Nodes[InPathId].ParentId;
+}
+
+FString FPathTable::GetPath(FPathId InPathId) const
+{
+	FString FullPath;
+	GetPath(InPathId, FullPath);
+	return FullPath;
+}
+
+void FPathTable::GetPath(FPathId InPathId, FString& OutPath) const
+{
+	FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+
+	// walk up to the root collecting segments
+	TArray<const FString*, TInlineAllocator<32> > Segments;
+	int32 Length = 0;
+	for (FPathId PathId = InPathId; PathId != INDEX_NONE; PathId = Nodes[PathId].ParentId)
+	{
+		Segments.Add(&Nodes[PathId].Segment);
+		Length += Nodes[PathId].Segment.Len() + 1;
+	}
+
+	// the separator counted for the last segment leaves room for a trailing one
+	OutPath.Reset(Length);
+	for (int32 i = Segments.Num() - 1; i >= 0; --i)
+	{
+		OutPath += *Segments[i];
+		if ((i > 0) || Nodes[InPathId].bIsDirectory)
+		{
+			OutPath += TEXT('/');
+		}
+	}
+}
+
+uint32 FPathTable::HashSegment(FPathId InParentId, const TCHAR* InSegment, int32 InSegmentLen)
+{
+	// FNV-1a
+	uint32 Hash = 2166136261u;
+	for (int32 i = 0; i < InSegmentLen; ++i)
+	{
+		const TCHAR Char = bIsCaseSensitive ? InSegment[i] : FChar::ToLower(InSegment[i]);
+		Hash = (Hash ^ (uint32)Char) * 16777619u;
+	}
+	return HashCombine(Hash, GetTypeHash(InParentId));
+}
+
+FPathId FPathTable::FindChild(
+	FPathId InParentId, const TCHAR* InSegment, int32 InSegmentLen, uint32 InHash
+) const
+{
+	for (auto It = NodesByHash.CreateConstKeyIterator(InHash); It; ++It)
+	{
+		const FNode& Node = Nodes[It.Value()];
+		if ((Node.ParentId == InParentId) 
+			&& (Node.Segment.Len() == InSegmentLen)
+			&& ((bIsCaseSensitive ? 
+				FCString::Strncmp(*Node.Segment, InSegment, InSegmentLen) : 
+				FCString::Strnicmp(*Node.Segment, InSegment, InSegmentLen)) == 0))
+		{
+			return It.Value();
+		}
+	}
+	return INDEX_NONE;
+}
+
+} // namespace MercurialSourceControl
@@ -0,0 +1,103 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+namespace MercurialSourceControl {
+
+/** Compact identifier of a path interned in the FPathTable. */
+typedef int32 FPathId;
+
+/**
+ * Interns absolute paths so that each one can be referred to by a compact integer ID.
+ *
+ * Paths are stored as a tree of path segments, each node only holds its own segment and the ID 
+ * of its parent directory, so the repository root and all the directories beneath it are stored 
+ * once no matter how many files they contain. Full paths are never stored, they're rebuilt from 
+ * the segments when requested. Lookups are case-insensitive on platforms whose file systems are
+ * case-insensitive by default (Windows and Mac), and case-sensitive everywhere else. On the former
+ * a path is rebuilt in the casing it was first interned with, which FString still considers equal
+ * to any other casing of it. A path that has been interned with a trailing separator is rebuilt 
+ * with one, so directories come back the way the editor names them.
+ *
+ * IDs are never reused or invalidated, it's safe to use the table from any thread.
+ */
+class FPathTable
+{
+public:
+	/** Get the table shared by everything in the plugin. */
+	static FPathTable& Get();
+
+	/** 
+	 * Get the ID of the given path, adding the path to the table if necessary.
+	 * @param InPath Absolute path with '/' separators.
+	 */
+	FPathId Intern(const FString& InPath);
+
+	/** Get the ID of the given path, or INDEX_NONE if the path has never been interned. */
+	FPathId Find(const FString& InPath) const;
+
+	/** Get the ID of the directory containing the given path, or INDEX_NONE for a root. */
+	FPathId GetParent(FPathId InPathId) const;
+
+	/** Build the full path corresponding to the given ID. */
+	FString GetPath(FPathId InPathId) const;
+
+	/** Build the full path corresponding to the given ID into the given buffer. */
+	void GetPath(FPathId InPathId, FString& OutPath) const;
+
+private:
+	struct FNode
+	{
+		FPathId ParentId;
+		/** Name of the file or directory, without any separators. */
+		FString Segment;
+		/** Has the path been interned with a trailing separator? */
+		bool bIsDirectory;
+	};
+
+	/** Should segments that only differ in case be treated as different? */
+	static const bool bIsCaseSensitive = !(PLATFORM_WINDOWS || PLATFORM_MAC);
+
+	/** Hash of a segment belonging to the given parent, case-insensitive unless paths aren't. */
+	static uint32 HashSegment(FPathId InParentId, const TCHAR* InSegment, int32 InSegmentLen);
+
+	/** Find the child of the given parent with the given name, lock must be held by the caller. */
+	FPathId FindChild(
+		FPathId InParentId, const TCHAR* InSegment, int32 InSegmentLen, uint32 InHash
+	) const;
+
+	/** 
+	 * Split the given path into segments and call the given function for each one.
+	 * The function should return false to stop the iteration early.
+	 */
+	template<typename FunctionType>
+	static void ForEachSegment(const FString& InPath, FunctionType Function);
+
+private:
+	TChunkedArray<FNode> Nodes;
+	TMultiMap<uint32, FPathId> NodesByHash;
+	mutable FRWLock Lock;
+};
+
+} // namespace MercurialSourceControl
@@ -0,0 +1,827 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlProcess.h"
+
+#if PLATFORM_WINDOWS
+#include "WindowsHWrapper.h"
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif // PLATFORM_WINDOWS
+
+namespace MercurialSourceControl {
+
+namespace 
+{
+	/** Maximum number of bytes to transfer through a pipe in one go. */
+	const int32 PipeChunkSize = 64 * 1024;
+
+	/** How long Pump() sleeps for when there's nothing to do. */
+	const float IdleSleepTime = 0.001f;
+
+	/** Used to generate unique names for input streams. */
+	FThreadSafeCounter NextInputStreamId;
+
+#if !PLATFORM_WINDOWS && !PLATFORM_LINUX
+	/** 
+	 * Without pipe2() a pipe can't be created with both ends already closed on exec, so 
+	 * descriptors are created and processes spawned one thread at a time, otherwise a process 
+	 * spawned from another thread could inherit a pipe and keep it open.
+	 */
+	FCriticalSection LaunchCriticalSection;
+#endif
+
+#if PLATFORM_WINDOWS
+	/** 
+	 * Create an anonymous pipe, only the end of the pipe that will be passed to the child 
+	 * process is inheritable, and our end of the pipe is non-blocking.
+	 */
+	bool CreateChildPipe(bool bChildReads, HANDLE& OutPipe, HANDLE& OutChildPipe)
+	{
+		SECURITY_ATTRIBUTES Attributes = { sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+		HANDLE ReadPipe = nullptr;
+		HANDLE WritePipe = nullptr;
+		if (!::CreatePipe(&ReadPipe, &WritePipe, &Attributes, 0))
+		{
+			return false;
+		}
+		OutPipe = bChildReads ? WritePipe : ReadPipe;
+		OutChildPipe = bChildReads ? ReadPipe : WritePipe;
+		DWORD Mode = PIPE_READMODE_BYTE | PIPE_NOWAIT;
+		::SetHandleInformation(OutPipe, HANDLE_FLAG_INHERIT, 0);
+		::SetNamedPipeHandleState(OutPipe, &Mode, nullptr, nullptr);
+		return true;
+	}
+#else
+	/** 
+	 * Create a pipe, both ends are closed on exec, the end of the pipe that will be passed to the
+	 * child process is guaranteed to be at least InMinChildPipe, and our end is non-blocking.
+	 */
+	bool CreateChildPipe(bool bChildReads, int32 InMinChildPipe, int32& OutPipe, int32& OutChildPipe)
+	{
+		int Pipes[2];
+#if PLATFORM_LINUX
+		if (pipe2(Pipes, O_CLOEXEC) != 0)
+		{
+			return false;
+		}
+#else
+		if (pipe(Pipes) != 0)
+		{
+			return false;
+		}
+		fcntl(Pipes[0], F_SETFD, FD_CLOEXEC);
+		fcntl(Pipes[1], F_SETFD, FD_CLOEXEC);
+#endif
+		OutPipe = bChildReads ? Pipes[1] : Pipes[0];
+		const int32 ChildPipe = bChildReads ? Pipes[0] : Pipes[1];
+		// keep the child's end clear of the descriptors it will be dup'ed to, otherwise 
+		// an earlier dup2 could clobber it before it's dup'ed
+		OutChildPipe = fcntl(ChildPipe, F_DUPFD_CLOEXEC, InMinChildPipe);
+		close(ChildPipe);
+		if (OutChildPipe < 0)
+		{
+			close(OutPipe);
+			return false;
+		}
+		fcntl(OutPipe, F_SETFL, fcntl(OutPipe, F_GETFL) | O_NONBLOCK);
+		return true;
+	}
+
+	/** 
+	 * Writing to a pipe whose reader has exited raises SIGPIPE, which would terminate the editor
+	 * unless something else has already decided how it should be handled.
+	 */
+	void IgnoreSigPipe()
+	{
+		struct sigaction Action;
+		if ((sigaction(SIGPIPE, nullptr, &Action) == 0) && (Action.sa_handler == SIG_DFL))
+		{
+			signal(SIGPIPE, SIG_IGN);
+		}
+	}
+
+	/** A null-terminated array of null-terminated strings, as expected by posix_spawn(). */
+	class FCStringArray
+	{
+	public:
+		void Add(const ANSICHAR* InString, int32 InLength)
+		{
+			TArray<ANSICHAR>& String = Strings[Strings.AddDefaulted()];
+			String.Append(InString, InLength);
+			String.Add('\0');
+		}
+
+		char* const* Get()
+		{
+			Pointers.Reset(Strings.Num() + 1);
+			for (TArray<ANSICHAR>& String : Strings)
+			{
+				Pointers.Add(String.GetData());
+			}
+			Pointers.Add(nullptr);
+			return Pointers.GetData();
+		}
+
+	private:
+		TArray<TArray<ANSICHAR>> Strings;
+		TArray<char*> Pointers;
+	};
+
+	/** 
+	 * Split a command line into individual arguments, arguments are separated by whitespace 
+	 * unless enclosed in double-quotes.
+	 */
+	void SplitArguments(const FString& InArguments, TArray<FString>& OutArguments)
+	{
+		FString Argument;
+		bool bInArgument = false;
+		bool bInQuotes = false;
+		for (const TCHAR Char : InArguments)
+		{
+			if (Char == TEXT('"'))
+			{
+				bInQuotes = !bInQuotes;
+				bInArgument = true;
+			}
+			else if (!bInQuotes && FChar::IsWhitespace(Char))
+			{
+				if (bInArgument)
+				{
+					OutArguments.Add(MoveTemp(Argument));
+					Argument.Empty();
+					bInArgument = false;
+				}
+			}
+			else
+			{
+				Argument.AppendChar(Char);
+				bInArgument = true;
+			}
+		}
+		if (bInArgument)
+		{
+			OutArguments.Add(MoveTemp(Argument));
+		}
+	}
+#endif // PLATFORM_WINDOWS
+} // unnamed namespace
+
+#if PLATFORM_WINDOWS
+const FProcess::FPipe FProcess::InvalidPipe = nullptr;
+#else
+const FProcess::FPipe FProcess::InvalidPipe = -1;
+#endif
+
+FProcess::FProcess()
+: StdoutPipe(InvalidPipe)
+, StderrPipe(InvalidPipe)
+, ReturnCode(-1)
+, bRunning(false)
+#if PLATFORM_WINDOWS
+, ProcessHandle(nullptr)
+, JobHandle(nullptr)
+#else
+, ProcessId(-1)
+#endif
+{
+	// stdin is always the first input stream
+	InputStreams.AddDefaulted(1);
+}
+
+FProcess::~FProcess()
+{
+	CloseAll();
+#if PLATFORM_WINDOWS
+	if (ProcessHandle)
+	{
+		::CloseHandle(ProcessHandle);
+	}
+	if (JobHandle)
+	{
+		::CloseHandle(JobHandle);
+	}
+#else
+	if (ProcessId > 0)
+	{
+		// reap the child if it's already exited so it doesn't linger as a zombie
+		int Status = 0;
+		waitpid(ProcessId, &Status, WNOHANG);
+	}
+#endif
+}
+
+void FProcess::SetStdin(TArray<uint8>&& InData)
+{
+	check(!bRunning);
+	InputStreams[0].Data = MoveTemp(InData);
+}
+
+void FProcess::SetEnvironmentVariable(const FString& InName, const FString& InValue)
+{
+	check(!bRunning);
+	EnvironmentVariables.Add(InName, InValue);
+}
+
+FString FProcess::AddInputStream(TArray<uint8>&& InData)
+{
+	check(!bRunning);
+	const int32 Index = InputStreams.AddDefaulted();
+	FInputStream& Stream = InputStreams[Index];
+	Stream.Data = MoveTemp(InData);
+#if PLATFORM_WINDOWS
+	Stream.Name = FString::Printf(
+		TEXT("\\\\.\\pipe\\MercurialSourceControl-%u-%d"), 
+		FPlatformProcess::GetCurrentProcessId(), NextInputStreamId.Increment()
+	);
+#else
+	// stdin is descriptor 0 and the first input stream, the additional streams follow stderr
+	Stream.Name = FString::Printf(TEXT("/dev/fd/%d"), Index + 2);
+#endif
+	return Stream.Name;
+}
+
+#if PLATFORM_WINDOWS
+
+bool FProcess::Launch(const FString& InExecutable, const FString& InArguments)
+{
+	check(!bRunning);
+	Reset();
+
+	HANDLE ChildStdout = nullptr;
+	HANDLE ChildStderr = nullptr;
+	bool bPipesCreated = 
+		CreateChildPipe(true, InputStreams[0].Pipe, InputStreams[0].ChildPipe) &&
+		CreateChildPipe(false, StdoutPipe, ChildStdout) &&
+		CreateChildPipe(false, StderrPipe, ChildStderr);
+	InputStreams[0].bConnected = true;
+
+	for (int32 i = 1; bPipesCreated && (i < InputStreams.Num()); ++i)
+	{
+		FInputStream& Stream = InputStreams[i];
+		Stream.Pipe = ::CreateNamedPipeW(
+			*Stream.Name, PIPE_ACCESS_OUTBOUND | FILE_FLAG_FIRST_PIPE_INSTANCE,
+			PIPE_TYPE_BYTE | PIPE_NOWAIT | PIPE_REJECT_REMOTE_CLIENTS, 1, PipeChunkSize, 0, 0, 
+			nullptr
+		);
+		if (Stream.Pipe == INVALID_HANDLE_VALUE)
+		{
+			Stream.Pipe = nullptr;
+			bPipesCreated = false;
+		}
+	}
+
+	bool bCreated = false;
+	if (bPipesCreated)
+	{
+		// Only let the child inherit its own pipes, otherwise processes launched concurrently
+		// from other threads could end up holding on to them too.
+		HANDLE InheritedHandles[] = { InputStreams[0].ChildPipe, ChildStdout, ChildStderr };
+		SIZE_T AttributeListSize = 0;
+		::InitializeProcThreadAttributeList(nullptr, 1, 0, &AttributeListSize);
+		TArray<uint8> AttributeList;
+		AttributeList.SetNumUninitialized((int32)AttributeListSize);
+
+		STARTUPINFOEXW StartupInfo;
+		FMemory::Memzero(StartupInfo);
+		StartupInfo.StartupInfo.cb = sizeof(StartupInfo);
+		StartupInfo.StartupInfo.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
+		StartupInfo.StartupInfo.wShowWindow = SW_HIDE;
+		StartupInfo.StartupInfo.hStdInput = InputStreams[0].ChildPipe;
+		StartupInfo.StartupInfo.hStdOutput = ChildStdout;
+		StartupInfo.StartupInfo.hStdError = ChildStderr;
+		StartupInfo.lpAttributeList = (LPPROC_THREAD_ATTRIBUTE_LIST)AttributeList.GetData();
+
+		if (::InitializeProcThreadAttributeList(
+				StartupInfo.lpAttributeList, 1, 0, &AttributeListSize))
+		{
+			if (::UpdateProcThreadAttribute(
+					StartupInfo.lpAttributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, 
+					InheritedHandles, sizeof(InheritedHandles), nullptr, nullptr))
+			{
+				FString CommandLine = FString::Printf(
+					TEXT("\"%s\" %s"), *InExecutable, *InArguments
+				);
+				TArray<TCHAR> Environment;
+				BuildEnvironmentBlock(Environment);
+				PROCESS_INFORMATION ProcessInfo;
+				// the process is started suspended so it can be put in a job object before it 
+				// gets a chance to start any processes of its own
+				bCreated = !!::CreateProcessW(
+					*InExecutable, CommandLine.GetCharArray().GetData(), nullptr, nullptr, TRUE,
+					EXTENDED_STARTUPINFO_PRESENT | CREATE_NO_WINDOW | CREATE_SUSPENDED | 
+					CREATE_UNICODE_ENVIRONMENT, 
+					(Environment.Num() > 0) ? Environment.GetData() : nullptr, nullptr, 
+					&StartupInfo.StartupInfo, &ProcessInfo
+				);
+				if (bCreated)
+				{
+					// if this fails (e.g. the editor is itself in a job on an older version of 
+					// Windows) only the process itself can be terminated
+					JobHandle = ::CreateJobObjectW(nullptr, nullptr);
+					if (JobHandle && !::AssignProcessToJobObject(JobHandle, ProcessInfo.hProcess))
+					{
+						::CloseHandle(JobHandle);
+						JobHandle = nullptr;
+					}
+					::ResumeThread(ProcessInfo.hThread);
+					::CloseHandle(ProcessInfo.hThread);
+					ProcessHandle = ProcessInfo.hProcess;
+				}
+			}
+			::DeleteProcThreadAttributeList(StartupInfo.lpAttributeList);
+		}
+	}
+
+	// the child has its own copies of these now
+	ClosePipe(InputStreams[0].ChildPipe);
+	ClosePipe(ChildStdout);
+	ClosePipe(ChildStderr);
+
+	if (!bCreated)
+	{
+		CloseAll();
+		return false;
+	}
+	bRunning = true;
+	return true;
+}
+
+void FProcess::BuildEnvironmentBlock(TArray<TCHAR>& OutBlock) const
+{
+	if (EnvironmentVariables.Num() == 0)
+	{
+		return;
+	}
+
+	// inherit our environment, except for the variables that are overridden
+	LPWCH Strings = ::GetEnvironmentStringsW();
+	for (const TCHAR* Variable = Strings; Variable && *Variable; )
+	{
+		const int32 Length = FCString::Strlen(Variable);
+		// names of hidden variables (e.g. =C:) start with an '=' which isn't a separator
+		const TCHAR* Separator = FCString::Strchr(Variable + 1, TEXT('='));
+		const FString Name = Separator ? 
+			FString((int32)(Separator - Variable), Variable) : FString(Variable);
+		bool bOverridden = false;
+		for (const auto& Override : EnvironmentVariables)
+		{
+			// variable names are case-insensitive on Windows
+			bOverridden |= (Override.Key == Name);
+		}
+		if (!bOverridden)
+		{
+			OutBlock.Append(Variable, Length + 1);
+		}
+		Variable += Length + 1;
+	}
+	if (Strings)
+	{
+		::FreeEnvironmentStringsW(Strings);
+	}
+
+	for (const auto& Variable : EnvironmentVariables)
+	{
+		const FString String = Variable.Key + TEXT("=") + Variable.Value;
+		OutBlock.Append(*String, String.Len() + 1);
+	}
+	// the block is terminated by an empty string
+	OutBlock.Add(TEXT('\0'));
+}
+
+bool FProcess::WriteInput(FInputStream& InStream)
+{
+	if (!InStream.Pipe)
+	{
+		return false;
+	}
+
+	if (!InStream.bConnected)
+	{
+		if (::ConnectNamedPipe(InStream.Pipe, nullptr))
+		{
+			InStream.bConnected = true;
+		}
+		else
+		{
+			const DWORD Error = ::GetLastError();
+			if (Error == ERROR_PIPE_CONNECTED)
+			{
+				InStream.bConnected = true;
+			}
+			else if (Error == ERROR_PIPE_LISTENING)
+			{
+				return false;
+			}
+			else
+			{
+				// the child connected and went away again, or something went horribly wrong
+				ClosePipe(InStream.Pipe);
+				return true;
+			}
+		}
+	}
+
+	bool bProgress = false;
+	const int32 Remaining = InStream.Data.Num() - InStream.Offset;
+	if (Remaining > 0)
+	{
+		DWORD BytesWritten = 0;
+		if (::WriteFile(
+				InStream.Pipe, InStream.Data.GetData() + InStream.Offset, 
+				(DWORD)FMath::Min(Remaining, PipeChunkSize), &BytesWritten, nullptr))
+		{
+			InStream.Offset += (int32)BytesWritten;
+			bProgress = (BytesWritten > 0);
+		}
+		else
+		{
+			// the child closed its end, it isn't interested in the rest of the data
+			InStream.Offset = InStream.Data.Num();
+		}
+	}
+
+	if (InStream.Offset >= InStream.Data.Num())
+	{
+		// the child will see the end of the stream once it's read everything in the pipe
+		ClosePipe(InStream.Pipe);
+		bProgress = true;
+	}
+	return bProgress;
+}
+
+bool FProcess::ReadOutput(FPipe InPipe, TArray<uint8>& OutOutput)
+{
+	if (!InPipe)
+	{
+		return false;
+	}
+
+	DWORD BytesAvailable = 0;
+	if (!::PeekNamedPipe(InPipe, nullptr, 0, nullptr, &BytesAvailable, nullptr) ||
+		(BytesAvailable == 0))
+	{
+		return false;
+	}
+
+	const int32 Offset = OutOutput.Num();
+	const int32 BytesToRead = FMath::Min((int32)BytesAvailable, PipeChunkSize);
+	OutOutput.AddUninitialized(BytesToRead);
+	DWORD BytesRead = 0;
+	if (!::ReadFile(InPipe, OutOutput.GetData() + Offset, BytesToRead, &BytesRead, nullptr))
+	{
+		BytesRead = 0;
+	}
+	OutOutput.SetNum(Offset + (int32)BytesRead, false);
+	return BytesRead > 0;
+}
+
+bool FProcess::Interrupt()
+{
+	// hg is launched without a console (and in its own job), so there's no console it shares 
+	// with the editor that a CTRL_BREAK_EVENT could be delivered through
+	return false;
+}
+
+void FProcess::Terminate()
+{
+	if (!bRunning)
+	{
+		return;
+	}
+
+	if (!JobHandle || !::TerminateJobObject(JobHandle, 1))
+	{
+		::TerminateProcess(ProcessHandle, 1);
+	}
+}
+
+bool FProcess::IsRunning()
+{
+	if (::WaitForSingleObject(ProcessHandle, 0) == WAIT_TIMEOUT)
+	{
+		return true;
+	}
+
+	DWORD ExitCode = 0;
+	ReturnCode = ::GetExitCodeProcess(ProcessHandle, &ExitCode) ? (int32)ExitCode : -1;
+	return false;
+}
+
+void FProcess::ClosePipe(FPipe& InOutPipe)
+{
+	if (InOutPipe)
+	{
+		::CloseHandle(InOutPipe);
+		InOutPipe = nullptr;
+	}
+}
+
+#else
+
+bool FProcess::Launch(const FString& InExecutable, const FString& InArguments)
+{
+	check(!bRunning);
+	Reset();
+
+	IgnoreSigPipe();
+
+#if !PLATFORM_LINUX
+	FScopeLock LaunchLock(&LaunchCriticalSection);
+#endif
+
+	// descriptors 0, 1, 2, followed by the additional input streams
+	const int32 NumChildPipes = InputStreams.Num() + 2;
+	int32 ChildStdout = InvalidPipe;
+	int32 ChildStderr = InvalidPipe;
+	bool bPipesCreated = 
+		CreateChildPipe(false, NumChildPipes, StdoutPipe, ChildStdout) &&
+		CreateChildPipe(false, NumChildPipes, StderrPipe, ChildStderr);
+	for (int32 i = 0; bPipesCreated && (i < InputStreams.Num()); ++i)
+	{
+		FInputStream& Stream = InputStreams[i];
+		bPipesCreated = CreateChildPipe(true, NumChildPipes, Stream.Pipe, Stream.ChildPipe);
+		Stream.bConnected = true;
+	}
+
+	bool bCreated = false;
+	if (bPipesCreated)
+	{
+		posix_spawn_file_actions_t FileActions;
+		posix_spawn_file_actions_init(&FileActions);
+		posix_spawn_file_actions_adddup2(&FileActions, InputStreams[0].ChildPipe, STDIN_FILENO);
+		posix_spawn_file_actions_adddup2(&FileActions, ChildStdout, STDOUT_FILENO);
+		posix_spawn_file_actions_adddup2(&FileActions, ChildStderr, STDERR_FILENO);
+		for (int32 i = 1; i < InputStreams.Num(); ++i)
+		{
+			posix_spawn_file_actions_adddup2(&FileActions, InputStreams[i].ChildPipe, i + 2);
+		}
+
+		TArray<FString> Arguments;
+		Arguments.Add(InExecutable);
+		SplitArguments(InArguments, Arguments);
+		FCStringArray Argv;
+		for (const FString& Argument : Arguments)
+		{
+			FTCHARToUTF8 Converter(*Argument);
+			Argv.Add(Converter.Get(), Converter.Length());
+		}
+
+		// inherit our environment, except for the variables that are overridden
+		FCStringArray Envp;
+		for (char** Variable = environ; *Variable; ++Variable)
+		{
+			const ANSICHAR* Separator = FCStringAnsi::Strchr(*Variable, '=');
+			const FString Name = Separator ? 
+				FString((int32)(Separator - *Variable), *Variable) : FString(*Variable);
+			if (!EnvironmentVariables.Contains(Name))
+			{
+				Envp.Add(*Variable, FCStringAnsi::Strlen(*Variable));
+			}
+		}
+		for (const auto& Variable : EnvironmentVariables)
+		{
+			FTCHARToUTF8 Converter(*(Variable.Key + TEXT("=") + Variable.Value));
+			Envp.Add(Converter.Get(), Converter.Length());
+		}
+
+		// put the process in a new process group so the whole process tree can be terminated
+		posix_spawnattr_t Attributes;
+		posix_spawnattr_init(&Attributes);
+		posix_spawnattr_setflags(&Attributes, POSIX_SPAWN_SETPGROUP);
+		posix_spawnattr_setpgroup(&Attributes, 0);
+
+		pid_t Pid = -1;
+		bCreated = posix_spawn(
+			&Pid, Argv.Get()[0], &FileActions, &Attributes, Argv.Get(), Envp.Get()
+		) == 0;
+		posix_spawnattr_destroy(&Attributes);
+		posix_spawn_file_actions_destroy(&FileActions);
+		if (bCreated)
+		{
+			ProcessId = Pid;
+		}
+	}
+
+	// the child has its own copies of these now
+	for (FInputStream& Stream : InputStreams)
+	{
+		ClosePipe(Stream.ChildPipe);
+	}
+	ClosePipe(ChildStdout);
+	ClosePipe(ChildStderr);
+
+	if (!bCreated)
+	{
+		CloseAll();
+		return false;
+	}
+	bRunning = true;
+	return true;
+}
+
+bool FProcess::WriteInput(FInputStream& InStream)
+{
+	if (InStream.Pipe == InvalidPipe)
+	{
+		return false;
+	}
+
+	bool bProgress = false;
+	const int32 Remaining = InStream.Data.Num() - InStream.Offset;
+	if (Remaining > 0)
+	{
+		const ssize_t BytesWritten = write(
+			InStream.Pipe, InStream.Data.GetData() + InStream.Offset, 
+			FMath::Min(Remaining, PipeChunkSize)
+		);
+		if (BytesWritten > 0)
+		{
+			InStream.Offset += (int32)BytesWritten;
+			bProgress = true;
+		}
+		else if ((BytesWritten < 0) && (errno != EAGAIN) && (errno != EINTR))
+		{
+			// the child closed its end, it isn't interested in the rest of the data
+			InStream.Offset = InStream.Data.Num();
+		}
+	}
+
+	if (InStream.Offset >= InStream.Data.Num())
+	{
+		// the child will see the end of the stream once it's read everything in the pipe
+		ClosePipe(InStream.Pipe);
+		bProgress = true;
+	}
+	return bProgress;
+}
+
+bool FProcess::ReadOutput(FPipe InPipe, TArray<uint8>& OutOutput)
+{
+	if (InPipe == InvalidPipe)
+	{
+		return false;
+	}
+
+	const int32 Offset = OutOutput.Num();
+	OutOutput.AddUninitialized(PipeChunkSize);
+	const ssize_t BytesRead = read(InPipe, OutOutput.GetData() + Offset, PipeChunkSize);
+	OutOutput.SetNum(Offset + FMath::Max((int32)BytesRead, 0), false);
+	// end of file is handled by waiting for the process to exit rather than by closing the pipe,
+	// grandchildren may still be holding on to it
+	return BytesRead > 0;
+}
+
+bool FProcess::Interrupt()
+{
+	if (bRunning && (ProcessId > 0))
+	{
+		return kill(-ProcessId, SIGINT) == 0;
+	}
+	return false;
+}
+
+void FProcess::Terminate()
+{
+	if (bRunning && (ProcessId > 0))
+	{
+		kill(-ProcessId, SIGKILL);
+	}
+}
+
+bool FProcess::IsRunning()
+{
+	int Status = 0;
+	const pid_t Result = waitpid(ProcessId, &Status, WNOHANG);
+	if ((Result == 0) || ((Result < 0) && (errno == EINTR)))
+	{
+		return true;
+	}
+
+	ReturnCode = ((Result == ProcessId) && WIFEXITED(Status)) ? WEXITSTATUS(Status) : -1;
+	ProcessId = -1;
+	return false;
+}
+
+void FProcess::ClosePipe(FPipe& InOutPipe)
+{
+	if (InOutPipe != InvalidPipe)
+	{
+		close(InOutPipe);
+		InOutPipe = InvalidPipe;
+	}
+}
+
+#endif // PLATFORM_WINDOWS
+
+bool FProcess::Pump()
+{
+	if (!bRunning)
+	{
+		return false;
+	}
+
+	bool bProgress = false;
+	for (FInputStream& Stream : InputStreams)
+	{
+		bProgress |= WriteInput(Stream);
+	}
+	bProgress |= ReadOutput(StdoutPipe, Stdout);
+	bProgress |= ReadOutput(StderrPipe, Stderr);
+
+	if (!IsRunning())
+	{
+		// whatever the process wrote before it exited is still sitting in the pipes
+		while (ReadOutput(StdoutPipe, Stdout) | ReadOutput(StderrPipe, Stderr))
+		{
+		}
+		CloseAll();
+		bRunning = false;
+		return false;
+	}
+
+	if (!bProgress)
+	{
+		FPlatformProcess::Sleep(IdleSleepTime);
+	}
+	return true;
+}
+
+void FProcess::Wait()
+{
+	while (Pump())
+	{
+	}
+}
+
+FString FProcess::OutputToString(const TArray<uint8>& InOutput)
+{
+	FUTF8ToTCHAR Converter((const ANSICHAR*)InOutput.GetData(), InOutput.Num());
+	return FString(Converter.Length(), Converter.Get());
+}
+
+void FProcess::Reset()
+{
+	for (FInputStream& Stream : InputStreams)
+	{
+		Stream.Offset = 0;
+		Stream.bConnected = false;
+	}
+	Stdout.Reset();
+	Stderr.Reset();
+	ReturnCode = -1;
+#if PLATFORM_WINDOWS
+	if (ProcessHandle)
+	{
+		::CloseHandle(ProcessHandle);
+		ProcessHandle = nullptr;
+	}
+	if (JobHandle)
+	{
+		::CloseHandle(JobHandle);
+		JobHandle = nullptr;
+	}
+#endif
+}
+
+void FProcess::CloseAll()
+{
+	for (FInputStream& Stream : InputStreams)
+	{
+		ClosePipe(Stream.Pipe);
+		ClosePipe(Stream.ChildPipe);
+	}
+	ClosePipe(StdoutPipe);
+	ClosePipe(StderrPipe);
+}
+
+} // namespace MercurialSourceControl
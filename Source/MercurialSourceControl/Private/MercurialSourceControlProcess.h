@@ -0,0 +1,184 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+namespace MercurialSourceControl {
+
+/** 
+ * Runs a child process with redirected stdin, stdout, and stderr.
+ * Unlike FPlatformProcess::ExecProcess() the child process can be fed data through its stdin 
+ * and through any number of additional input streams, none of which touch the file system. 
+ * All the pipes are serviced without blocking from Pump(), so a child that writes a lot of 
+ * output before it finishes reading its input can't deadlock.
+ */
+class FProcess
+{
+public:
+	FProcess();
+	~FProcess();
+
+	/** 
+	 * Set the data that should be written to the stdin of the process, stdin will be closed 
+	 * once all the data has been written. If no data is set stdin will be closed right away.
+	 * @note Must be called before Launch().
+	 */
+	void SetStdin(TArray<uint8>&& InData);
+
+	/** 
+	 * Set an environment variable for the process, the rest of the environment is inherited 
+	 * from the calling process.
+	 * @note Must be called before Launch().
+	 */
+	void SetEnvironmentVariable(const FString& InName, const FString& InValue);
+
+	/** 
+	 * Add a stream of data the process can read by opening the returned filename, the stream 
+	 * will be closed once all the data has been written to it. On Windows the stream is a named 
+	 * pipe, on other platforms it's an inherited file descriptor.
+	 * @note Must be called before Launch().
+	 */
+	FString AddInputStream(TArray<uint8>&& InData);
+
+	/** Check if any additional input streams have been added via AddInputStream(). */
+	bool HasInputStreams() const { return InputStreams.Num() > 1; }
+
+	/** 
+	 * Start the process. Once a process has exited it may be launched again (e.g. to retry a
+	 * failed command), in which case all of its input will be written to it again.
+	 * @param InExecutable Absolute path to the executable.
+	 * @param InArguments Command line arguments, arguments that contain spaces must be enclosed
+	 *                    in double-quotes.
+	 * @return false if the process couldn't be started.
+	 */
+	bool Launch(const FString& InExecutable, const FString& InArguments);
+
+	/** 
+	 * Write any pending input to the process and read any output it produced, if there was 
+	 * nothing to do sleep for a little while.
+	 * @return true if the process is still running, false once it has exited and all of its 
+	 *         output has been read.
+	 */
+	bool Pump();
+
+	/** Pump() until the process exits. */
+	void Wait();
+
+	/** 
+	 * Ask the process to stop, giving it a chance to clean up (hg rolls back any transaction 
+	 * that's in progress and releases its locks). On POSIX platforms this sends SIGINT to the 
+	 * process group, which chg also forwards to its command server. 
+	 * Pump() or Wait() must still be called afterwards to reap the process.
+	 * @return false if the process can't be interrupted on this platform, in which case it 
+	 *         can only be terminated.
+	 */
+	bool Interrupt();
+
+	/** 
+	 * Forcibly terminate the process, along with any processes it started. 
+	 * Pump() or Wait() must still be called afterwards to reap the process.
+	 * @note A process killed this way gets no chance to clean up, Interrupt() it first.
+	 */
+	void Terminate();
+
+	/** Get the exit code of the process, only valid after Pump() returned false. */
+	int32 GetReturnCode() const { return ReturnCode; }
+
+	/** Get everything the process has written to stdout so far. */
+	const TArray<uint8>& GetStdout() const { return Stdout; }
+
+	/** Get everything the process has written to stderr so far. */
+	const TArray<uint8>& GetStderr() const { return Stderr; }
+
+	/** Convert output from the process (which is expected to be in UTF-8) to a string. */
+	static FString OutputToString(const TArray<uint8>& InOutput);
+
+private:
+#if PLATFORM_WINDOWS
+	typedef void* FPipe;
+#else
+	typedef int32 FPipe;
+#endif
+
+	/** Value of an FPipe that doesn't refer to a pipe. */
+	static const FPipe InvalidPipe;
+
+	struct FInputStream
+	{
+		FInputStream()
+		: Pipe(InvalidPipe)
+		, ChildPipe(InvalidPipe)
+		, Offset(0)
+		, bConnected(false)
+		{
+		}
+
+
+		/** Our end of the pipe, or invalid if it's been closed. */
+		FPipe Pipe;
+		/** The end of the pipe the child process inherits, if any. */
+		FPipe ChildPipe;
+		/** Name the child process should open to read from the stream. */
+		FString Name;
+		TArray<uint8> Data;
+		int32 Offset;
+		/** Only used for named pipes, true once the child process opened the pipe. */
+		bool bConnected;
+	};
+
+#if PLATFORM_WINDOWS
+	/** Build the environment block for the process, leave it empty to inherit ours as is. */
+	void BuildEnvironmentBlock(TArray<TCHAR>& OutBlock) const;
+#endif
+
+	bool WriteInput(FInputStream& InStream);
+	bool ReadOutput(FPipe InPipe, TArray<uint8>& OutOutput);
+	bool IsRunning();
+	/** Clear everything left over from a previous launch. */
+	void Reset();
+	void CloseAll();
+
+	static void ClosePipe(FPipe& InOutPipe);
+
+private:
+	/** Environment variables that should be set for the process. */
+	TMap<FString, FString> EnvironmentVariables;
+	/** The stdin stream, followed by the additional input streams. */
+	TArray<FInputStream> InputStreams;
+	FPipe StdoutPipe;
+	FPipe StderrPipe;
+	TArray<uint8> Stdout;
+	TArray<uint8> Stderr;
+	int32 ReturnCode;
+	bool bRunning;
+#if PLATFORM_WINDOWS
+	void* ProcessHandle;
+	/** Job object the process is assigned to, so the whole process tree can be terminated. */
+	void* JobHandle;
+#else
+	/** Also the ID of the process group that contains the process tree. */
+	int32 ProcessId;
+#endif
+};
+
+} // namespace MercurialSourceControl
@@ -28,6 +28,8 @@
 #include "MercurialSourceControlCommand.h"
 #include "MercurialSourceControlFileState.h"
 #include "MercurialSourceControlClient.h"
+#include "MercurialSourceControlFileStateSnapshot.h"
+#include "MercurialSourceControlStateTransitions.h"
 #include "MessageLog.h"
 #include "ScopedSourceControlProgress.h"
 #include "MercurialSourceControlOperationNames.h"
@@ -45,13 +47,59 @@ FName FProvider::SourceControlLogName("SourceControl");
 void FProvider::Init(bool bForceConnection)
 {
 	Settings.Load();
-	AbsoluteContentDirectory = FPaths::ConvertRelativePathToFull(FPaths::ProjectContentDir());
+	PathNormalizer.Initialize();
+	AbsoluteContentDirectory = PathNormalizer.ToAbsolute(FPaths::ProjectContentDir());
+
+	if (!ThreadPool.IsValid() && !ThreadPool.Create(Settings))
+	{
+		UE_LOG(
+			LogSourceControl, Warning, 
+			TEXT("Mercurial commands will be executed on the shared engine thread pool.")
+		);
+	}
+	Scheduler.Startup();
+
+	// display the states from the previous session until they're refreshed
+	TArray<FFileState> SnapshotStates;
+	if (FFileStateSnapshot::Load(SnapshotStates))
+	{
+		FileStateCache.Update(SnapshotStates, PendingChangedFiles);
+	}
 }
 
 void FProvider::Close()
 {
-	// clear out the file state cache
-	FileStateMap.Empty();
+	// don't lose any mutations that haven't been executed yet
+	FlushMutationJournal(EConcurrency::Synchronous);
+
+	// abandon any commands that haven't started yet and wait for the rest to finish
+	Scheduler.Shutdown();
+	ThreadPool.Destroy();
+
+	// every queued command has now either finished or been cancelled, and whoever 
+	// queued it still expects to hear back
+	TArray<FCommandQueueEntry> CompletedCommands = MoveTemp(CommandQueue);
+	CommandQueue.Empty();
+	TArray<FPathId> ChangedFiles;
+	for (const auto& CommandQueueEntry : CompletedCommands)
+	{
+		check(CommandQueueEntry.Command->HasExecuted());
+		CommandQueueEntry.Command->UpdateStates(ChangedFiles);
+		CommandQueueEntry.Command->NotifyOperationComplete();
+		if (CommandQueueEntry.bAutoDelete)
+		{
+			delete CommandQueueEntry.Command;
+		}
+	}
+
+	// save the file state cache for the next session and clear it out
+	if (!RepositoryRoot.IsEmpty())
+	{
+		FFileStateSnapshot::Save(RepositoryRoot, FileStateCache);
+	}
+	FileStateCache.Empty();
+	PendingChangedFiles.Empty();
+	UnverifiedFiles.Empty();
 	// destroy the FClient singleton
 	FClient::Destroy();
 }
@@ -118,10 +166,7 @@ ECommandResult::Type FProvider::GetState(
 	}
 
 	TArray<FString> AbsoluteFiles;
-	for (const auto& Filename : InFiles)
-	{
-		AbsoluteFiles.Add(FPaths::ConvertRelativePathToFull(Filename));
-	}
+	PathNormalizer.ToAbsolute(InFiles, AbsoluteFiles);
 		
 	// update the cache if requested to do so
 	if (InStateCacheUsage == EStateCacheUsage::ForceUpdate)
@@ -132,9 +177,10 @@ ECommandResult::Type FProvider::GetState(
 	}
 
 	// retrieve the states for the given files from the cache
+	OutState.Reserve(OutState.Num() + AbsoluteFiles.Num());
 	for (const auto& Filename : AbsoluteFiles)
 	{
-		OutState.Add(GetFileStateFromCache(Filename));
+		OutState.Add(FileStateCache.FindOrAdd(Filename));
 	}
 
 	return ECommandResult::Succeeded;
@@ -168,6 +214,45 @@ ECommandResult::Type FProvider::Execute(
 		return ECommandResult::Failed;
 	}
 
+	TArray<FString> AbsoluteFiles;
+	TArray<FString> AbsoluteLargeFiles;
+	if (InOperation->GetName() == OperationNames::Connect)
+	{
+		AbsoluteFiles.Add(Settings.GetMercurialPath());
+	}
+	else if (InOperation->GetName() == OperationNames::MarkForAdd)
+	{
+		PrepareFilenamesForAddCommand(InFiles, AbsoluteFiles, AbsoluteLargeFiles);
+	}
+	else
+	{
+		PathNormalizer.ToAbsolute(InFiles, AbsoluteFiles);
+	}
+
+	// synchronous callers expect the mutation to have been made by the time this returns
+	if ((InConcurrency == EConcurrency::Asynchronous) && Settings.IsMutationJournalEnabled() 
+		&& JournalMutation(
+			InOperation, AbsoluteFiles, AbsoluteLargeFiles, InOperationCompleteDelegate
+		))
+	{
+		return ECommandResult::Succeeded;
+	}
+
+	// any other operation may depend on the outcome of the journaled mutations
+	FlushMutationJournal();
+
+	return ExecuteForFiles(
+		InOperation, AbsoluteFiles, AbsoluteLargeFiles, InConcurrency, InOperationCompleteDelegate
+	);
+}
+
+ECommandResult::Type FProvider::ExecuteForFiles(
+	const TSharedRef<ISourceControlOperation, ESPMode::ThreadSafe>& InOperation,
+	const TArray<FString>& InAbsoluteFiles, const TArray<FString>& InAbsoluteLargeFiles,
+	EConcurrency::Type InConcurrency,
+	const FSourceControlOperationComplete& InOperationCompleteDelegate
+)
+{
 	// attempt to create a worker to perform the requested operation
 	FWorkerPtr WorkerPtr = CreateWorker(InOperation->GetName());
 	if (!WorkerPtr.IsValid())
@@ -189,36 +274,17 @@ ECommandResult::Type FProvider::Execute(
 	}
 	
 	auto* Command = new FCommand(
-		GetWorkingDirectory(), AbsoluteContentDirectory, InOperation,
+		GetWorkingDirectory(), AbsoluteContentDirectory, FileStateCache, InOperation,
 		WorkerPtr.ToSharedRef(), InOperationCompleteDelegate
 	);
 
-	TArray<FString> AbsoluteFiles;
-	if (InOperation->GetName() == OperationNames::Connect)
-	{
-		AbsoluteFiles.Add(Settings.GetMercurialPath());
-	}
-	else if (InOperation->GetName() == OperationNames::MarkForAdd)
-	{
-		TArray<FString> AbsoluteLargeFiles;
-		PrepareFilenamesForAddCommand(InFiles, AbsoluteFiles, AbsoluteLargeFiles);
-		
-		if (AbsoluteLargeFiles.Num() > 0)
-		{
-			Command->SetAbsoluteLargeFiles(AbsoluteLargeFiles);
-		}
-	}
-	else
+	if (InAbsoluteFiles.Num() > 0)
 	{
-		for (const auto& Filename : InFiles)
-		{
-			AbsoluteFiles.Add(FPaths::ConvertRelativePathToFull(Filename));
-		}
+		Command->SetAbsoluteFiles(InAbsoluteFiles);
 	}
-
-	if (AbsoluteFiles.Num() > 0)
+	if (InAbsoluteLargeFiles.Num() > 0)
 	{
-		Command->SetAbsoluteFiles(AbsoluteFiles);
+		Command->SetAbsoluteLargeFiles(InAbsoluteLargeFiles);
 	}
 
 	if (InConcurrency == EConcurrency::Synchronous)
@@ -229,7 +295,7 @@ ECommandResult::Type FProvider::Execute(
 	}
 	else
 	{
-		return ExecuteCommand(Command, true);
+		return ExecuteCommand(Command, InConcurrency, true);
 	}
 }
 
@@ -237,7 +303,14 @@ bool FProvider::CanCancelOperation(
 	const TSharedRef<ISourceControlOperation, ESPMode::ThreadSafe>& InOperation
 ) const
 {
-	// don't support cancellation
+	for (const auto& CommandQueueEntry : CommandQueue)
+	{
+		if ((CommandQueueEntry.Command->GetOperation() == InOperation) && 
+			CanCancelCommand(*CommandQueueEntry.Command))
+		{
+			return true;
+		}
+	}
 	return false;
 }
 
@@ -245,7 +318,48 @@ void FProvider::CancelOperation(
 	const TSharedRef<ISourceControlOperation, ESPMode::ThreadSafe>& InOperation
 )
 {
-	// nothing to do here
+	for (const auto& CommandQueueEntry : CommandQueue)
+	{
+		FCommand* Command = CommandQueueEntry.Command;
+		if ((Command->GetOperation() != InOperation) || Command->HasExecuted())
+		{
+			continue;
+		}
+		// A command that modifies the repository may start executing at any moment, so it 
+		// has to be claimed before it does, otherwise it must be left alone.
+		bool bCancelled = true;
+		if (IsInterruptibleCommand(*Command))
+		{
+			Command->Cancel();
+		}
+		else
+		{
+			bCancelled = Command->CancelBeforeStart();
+		}
+		if (bCancelled)
+		{
+			// A command that's waiting to be executed is abandoned right away, one that's 
+			// already executing will stop its hg process, either way the command will be 
+			// completed (as cancelled) by the next Tick().
+			Scheduler.Cancel(Command);
+		}
+	}
+}
+
+bool FProvider::CanCancelCommand(const FCommand& InCommand)
+{
+	if (InCommand.HasExecuted())
+	{
+		return false;
+	}
+	return !InCommand.HasStarted() || IsInterruptibleCommand(InCommand);
+}
+
+bool FProvider::IsInterruptibleCommand(const FCommand& InCommand)
+{
+	const FName OperationName = InCommand.GetOperation()->GetName();
+	return (OperationName == OperationNames::UpdateStatus) || 
+		(OperationName == OperationNames::Connect);
 }
 
 TArray< TSharedRef<class ISourceControlLabel> > FProvider::GetLabels(
@@ -269,35 +383,67 @@ bool FProvider::UsesChangelists() const
 
 void FProvider::Tick()
 {
-	bool bNotifyStateChanged = false;
-
-	// remove commands that have finished executing from the queue
-	for (int32 i = 0; i < CommandQueue.Num(); ++i)
+	// Move all the commands that have finished executing out of the queue before processing any
+	// of them, NotifyOperationComplete() may indirectly alter the command queue (or even call
+	// Tick() again) so the queue must not be iterated while completion delegates are running.
+	TArray<FCommandQueueEntry> CompletedCommands;
+	for (int32 i = 0; i < CommandQueue.Num();)
 	{
-		FCommandQueueEntry CommandQueueEntry = CommandQueue[i];
-		auto* Command = CommandQueueEntry.Command;
-		if (Command->HasExecuted())
+		if (CommandQueue[i].Command->HasExecuted())
+		{
+			CompletedCommands.Add(CommandQueue[i]);
+			CommandQueue.RemoveAt(i, 1, false);
+		}
+		else
 		{
-			CommandQueue.RemoveAt(i);
-			bNotifyStateChanged = Command->UpdateStates();
-			LogErrors(Command->ErrorMessages);
-			Command->NotifyOperationComplete();
+			++i;
+		}
+	}
 
-			if (CommandQueueEntry.bAutoDelete)
-			{
-				delete Command;
-			}
+	// update the file state cache for the whole batch before notifying anyone,
+	// so that completion delegates see the states produced by every finished command
+	bool bNotifyStateChanged = PendingChangedFiles.Num() > 0;
+	TArray<FPathId> ChangedFiles = MoveTemp(PendingChangedFiles);
+	PendingChangedFiles.Reset();
+	for (const auto& CommandQueueEntry : CompletedCommands)
+	{
+		bNotifyStateChanged |= CommandQueueEntry.Command->UpdateStates(ChangedFiles);
+		// errors from a cancelled command are just fallout from terminating hg
+		if (CommandQueueEntry.Command->GetResult() != ECommandResult::Cancelled)
+		{
+			LogErrors(CommandQueueEntry.Command->ErrorMessages);
+		}
+	}
 
-			// NotifyOperationComplete() may indirectly alter the command queue 
-			// so the loop must stop here, the queue cleanup will resume on the
-			// next tick.
-			break;
+	for (const auto& CommandQueueEntry : CompletedCommands)
+	{
+		CommandQueueEntry.Command->NotifyOperationComplete();
+		if (CommandQueueEntry.bAutoDelete)
+		{
+			delete CommandQueueEntry.Command;
 		}
 	}
 
 	if (bNotifyStateChanged)
 	{
-		OnSourceControlStateChanged.Broadcast();
+		BroadcastStateChanged(ChangedFiles);
+	}
+
+	if (!MutationJournal.IsEmpty() && (FPlatformTime::Seconds() >= JournalFlushTime))
+	{
+		FlushMutationJournal();
+	}
+
+	if ((UnverifiedFiles.Num() > 0) && (FPlatformTime::Seconds() >= VerificationTime))
+	{
+		TArray<FString> Files;
+		Files.Reserve(UnverifiedFiles.Num());
+		for (FPathId PathId : UnverifiedFiles)
+		{
+			Files.Add(FPathTable::Get().GetPath(PathId));
+		}
+		UnverifiedFiles.Reset();
+		Execute(ISourceControlOperation::Create<FUpdateStatus>(), Files, EConcurrency::Asynchronous);
 	}
 }
 
@@ -340,54 +486,257 @@ void FProvider::RegisterWorkerCreator(
 
 bool FProvider::UpdateFileStateCache(const TArray<FFileState>& InStates)
 {
-	for (auto StateIt(InStates.CreateConstIterator()); StateIt; StateIt++)
-	{
-		FFileStateRef FileState = GetFileStateFromCache(StateIt->GetFilename());
-		FileState->SetFileStatus(StateIt->GetFileStatus());
-		FileState->SetTimeStamp(StateIt->GetTimeStamp());
-	}
-	return InStates.Num() > 0;
+	return FileStateCache.Update(InStates, PendingChangedFiles);
 }
 
 bool FProvider::UpdateFileStateCache(
 	const TMap<FString, TArray<FFileRevisionRef> >& InFileRevisionsMap
 )
 {
-	for (auto It(InFileRevisionsMap.CreateConstIterator()); It; ++It)
+	return FileStateCache.Update(InFileRevisionsMap, PendingChangedFiles);
+}
+
+bool FProvider::JournalMutation(
+	const TSharedRef<ISourceControlOperation, ESPMode::ThreadSafe>& InOperation,
+	const TArray<FString>& InAbsoluteFiles, const TArray<FString>& InAbsoluteLargeFiles,
+	const FSourceControlOperationComplete& InOperationCompleteDelegate
+)
+{
+	// how long to wait for further mutations before flushing the journal
+	const double JournalFlushDelaySeconds = 0.5;
+
+	EFileMutation Mutation;
+	EJournalIntent Intent;
+	if (InOperation->GetName() == OperationNames::MarkForAdd)
 	{
-		FFileStateRef FileState = GetFileStateFromCache(It.Key());
-		FileState->SetHistory(It.Value());
-		FileState->SetTimeStamp(FDateTime::Now());
+		Mutation = EFileMutation::Add;
+		Intent = EJournalIntent::Add;
 	}
-	return InFileRevisionsMap.Num() > 0;
+	else if (InOperation->GetName() == OperationNames::Delete)
+	{
+		Mutation = EFileMutation::Remove;
+		Intent = EJournalIntent::Remove;
+	}
+	else if (InOperation->GetName() == OperationNames::Revert)
+	{
+		Mutation = EFileMutation::Revert;
+		Intent = EJournalIntent::Revert;
+	}
+	else
+	{
+		return false;
+	}
+
+	TArray<TPair<FPathId, EJournalIntent> > Entries;
+	Entries.Reserve(InAbsoluteFiles.Num() + InAbsoluteLargeFiles.Num());
+	for (const auto& Filename : InAbsoluteFiles)
+	{
+		Entries.Emplace(FPathTable::Get().Intern(Filename), Intent);
+	}
+	for (const auto& Filename : InAbsoluteLargeFiles)
+	{
+		Entries.Emplace(FPathTable::Get().Intern(Filename), EJournalIntent::AddLarge);
+	}
+
+	// intents that can't be merged with the pending ones have to be recorded in a fresh journal
+	for (const auto& Entry : Entries)
+	{
+		if (!MutationJournal.CanRecord(Entry.Key, Entry.Value))
+		{
+			FlushMutationJournal();
+			break;
+		}
+	}
+
+	const int32 Owner = JournaledOperations.Add(
+		MakeShareable(new FJournaledOperation(InOperation, InOperationCompleteDelegate))
+	);
+	TArray<FPathId> JournaledFiles;
+	JournaledFiles.Reserve(Entries.Num());
+	for (const auto& Entry : Entries)
+	{
+		MutationJournal.Record(Entry.Key, Entry.Value, Owner);
+		JournaledFiles.Add(Entry.Key);
+	}
+	JournalFlushTime = FPlatformTime::Seconds() + JournalFlushDelaySeconds;
+
+	// show the expected states until the mutations are actually executed and verified
+	TArray<FPathId> PredictedFiles;
+	TArray<FString> UnpredictableFiles;
+	FStateTransitions::PublishPredictedStates(
+		Mutation, InAbsoluteFiles, FileStateCache, PendingChangedFiles, PredictedFiles, 
+		UnpredictableFiles
+	);
+	FStateTransitions::PublishPredictedStates(
+		Mutation, InAbsoluteLargeFiles, FileStateCache, PendingChangedFiles, PredictedFiles, 
+		UnpredictableFiles
+	);
+	VerifyStatesLater(JournaledFiles);
+	return true;
 }
 
-void FProvider::LogError(const FText& InErrorMessage)
+void FProvider::FlushMutationJournal(EConcurrency::Type InConcurrency)
 {
-	FMessageLog(SourceControlLogName).Error(InErrorMessage);
+	if (MutationJournal.IsEmpty())
+	{
+		return;
+	}
+
+	FJournalBatch AddBatch;
+	FJournalBatch LargeAddBatch;
+	FJournalBatch RemoveBatch;
+	FJournalBatch RevertBatch;
+	MutationJournal.Flush(AddBatch, LargeAddBatch, RemoveBatch, RevertBatch);
+	AddBatch.Owners.Append(LargeAddBatch.Owners);
+
+	// Each journaled operation is completed once all the commands its files were merged into 
+	// have completed. The pending commands of every operation must be counted before any of 
+	// the commands are executed, since a synchronous command completes right away.
+	TArray<TSharedRef<FJournaledOperation>> Operations = MoveTemp(JournaledOperations);
+	JournaledOperations.Reset();
+	auto CompleteOperations = [&Operations](const TSet<int32>& InOwners)
+	{
+		TArray<TSharedRef<FJournaledOperation>> OwnerOperations;
+		for (const int32 Owner : InOwners)
+		{
+			++Operations[Owner]->NumPendingCommands;
+			OwnerOperations.Add(Operations[Owner]);
+		}
+		return FSourceControlOperationComplete::CreateLambda(
+			[OwnerOperations](
+				const FSourceControlOperationRef& InOperation, ECommandResult::Type InResult
+			)
+			{
+				const FSourceControlResultInfo& ResultInfo = InOperation->GetResultInfo();
+				for (const TSharedRef<FJournaledOperation>& Owner : OwnerOperations)
+				{
+					// the caller only ever sees its own operation
+					for (const FText& Message : ResultInfo.InfoMessages)
+					{
+						Owner->Operation->AddInfoMessge(Message);
+					}
+					for (const FText& Message : ResultInfo.ErrorMessages)
+					{
+						Owner->Operation->AddErrorMessge(Message);
+					}
+					if (InResult != ECommandResult::Succeeded)
+					{
+						Owner->Result = InResult;
+					}
+					if (--Owner->NumPendingCommands == 0)
+					{
+						Owner->OperationCompleteDelegate.ExecuteIfBound(
+							Owner->Operation, Owner->Result
+						);
+					}
+				}
+			}
+		);
+	};
+
+	const bool bAdd = (AddBatch.Files.Num() > 0) || (LargeAddBatch.Files.Num() > 0);
+	const FSourceControlOperationComplete AddComplete = 
+		bAdd ? CompleteOperations(AddBatch.Owners) : FSourceControlOperationComplete();
+	const FSourceControlOperationComplete RemoveComplete = (RemoveBatch.Files.Num() > 0) ? 
+		CompleteOperations(RemoveBatch.Owners) : FSourceControlOperationComplete();
+	const FSourceControlOperationComplete RevertComplete = (RevertBatch.Files.Num() > 0) ? 
+		CompleteOperations(RevertBatch.Owners) : FSourceControlOperationComplete();
+
+	// the files of these operations cancelled out entirely, so there was nothing left to do
+	for (const TSharedRef<FJournaledOperation>& Operation : Operations)
+	{
+		if (Operation->NumPendingCommands == 0)
+		{
+			Operation->OperationCompleteDelegate.ExecuteIfBound(
+				Operation->Operation, ECommandResult::Succeeded
+			);
+		}
+	}
+
+	// each file only appears in one of the batches, so the order doesn't matter
+	const TArray<FString> None;
+	if (bAdd)
+	{
+		ExecuteForFiles(
+			ISourceControlOperation::Create<FMarkForAdd>(), AddBatch.Files, LargeAddBatch.Files, 
+			InConcurrency, AddComplete
+		);
+	}
+	if (RemoveBatch.Files.Num() > 0)
+	{
+		ExecuteForFiles(
+			ISourceControlOperation::Create<FDelete>(), RemoveBatch.Files, None, InConcurrency, 
+			RemoveComplete
+		);
+	}
+	if (RevertBatch.Files.Num() > 0)
+	{
+		ExecuteForFiles(
+			ISourceControlOperation::Create<FRevert>(), RevertBatch.Files, None, InConcurrency, 
+			RevertComplete
+		);
+	}
 }
 
-void FProvider::LogErrors(const TArray<FString>& ErrorMessages)
+void FProvider::VerifyStatesLater(const TArray<FPathId>& InFiles)
 {
-	FMessageLog SourceControlLog(SourceControlLogName);
-	for (auto It(ErrorMessages.CreateConstIterator()); It; ++It)
+	// how long to wait for further mutations before verifying predicted states
+	const double VerificationDelaySeconds = 2.0;
+
+	if (InFiles.Num() > 0)
 	{
-		SourceControlLog.Error(FText::FromString(*It));
+		UnverifiedFiles.Append(InFiles);
+		VerificationTime = FPlatformTime::Seconds() + VerificationDelaySeconds;
 	}
 }
 
-FFileStateRef FProvider::GetFileStateFromCache(const FString& Filename)
+FDelegateHandle FProvider::RegisterFileStatesChanged_Handle(
+	const FFileStatesChanged::FDelegate& InDelegate
+)
 {
-	FFileStateRef* StatePtr = FileStateMap.Find(Filename);
-	if (StatePtr)
+	return OnFileStatesChanged.Add(InDelegate);
+}
+
+void FProvider::UnregisterFileStatesChanged_Handle(FDelegateHandle Handle)
+{
+	OnFileStatesChanged.Remove(Handle);
+}
+
+void FProvider::BroadcastStateChanged(const TArray<FPathId>& InChangedFiles)
+{
+	OnSourceControlStateChanged.Broadcast();
+
+	if ((InChangedFiles.Num() > 0) && OnFileStatesChanged.IsBound())
 	{
-		return *StatePtr;
+		// the same file may have been changed by more than one command
+		TSet<FPathId> UniqueFiles;
+		UniqueFiles.Reserve(InChangedFiles.Num());
+		TArray<FString> ChangedFilenames;
+		ChangedFilenames.Reserve(InChangedFiles.Num());
+		for (FPathId PathId : InChangedFiles)
+		{
+			bool bAlreadyInSet = false;
+			UniqueFiles.Add(PathId, &bAlreadyInSet);
+			if (!bAlreadyInSet)
+			{
+				ChangedFilenames.Add(FPathTable::Get().GetPath(PathId));
+			}
+		}
+		OnFileStatesChanged.Broadcast(ChangedFilenames);
 	}
-	else
+}
+
+void FProvider::LogError(const FText& InErrorMessage)
+{
+	FMessageLog(SourceControlLogName).Error(InErrorMessage);
+}
+
+void FProvider::LogErrors(const TArray<FString>& ErrorMessages)
+{
+	FMessageLog SourceControlLog(SourceControlLogName);
+	for (auto It(ErrorMessages.CreateConstIterator()); It; ++It)
 	{
-		FFileStateRef DefaultFileState = MakeShareable(new FFileState(Filename));
-		FileStateMap.Add(Filename, DefaultFileState);
-		return DefaultFileState;
+		SourceControlLog.Error(FText::FromString(*It));
 	}
 }
 
@@ -399,14 +748,16 @@ ECommandResult::Type FProvider::ExecuteSynchronousCommand(
 	FScopedSourceControlProgress Progress(ProgressText);
 
 	// attempt to execute the command asynchronously
-	ExecuteCommand(Command, false);
+	ExecuteCommand(Command, EConcurrency::Synchronous, false);
 
-	// wait for the command to finish executing
+	// Wait for the command to finish executing, the wait is cut short as soon as the command 
+	// completes, but the timeout must be short enough to keep the progress dialog responsive.
+	const uint32 ProgressTickIntervalMs = 50;
 	while (!Command->HasExecuted())
 	{
+		Command->WaitForCompletion(ProgressTickIntervalMs);
 		Tick();
 		Progress.Tick();
-		FPlatformProcess::Sleep(0.01f);
 	}
 
 	// make sure the command queue is cleaned up
@@ -415,18 +766,23 @@ ECommandResult::Type FProvider::ExecuteSynchronousCommand(
 	return Command->GetResult();
 }
 
-ECommandResult::Type FProvider::ExecuteCommand(FCommand* Command, bool bAutoDelete)
+ECommandResult::Type FProvider::ExecuteCommand(
+	FCommand* Command, EConcurrency::Type InConcurrency, bool bAutoDelete
+)
 {
-	if (GThreadPool)
+	if (Scheduler.Submit(Command, GetCommandLane(*Command, InConcurrency)))
 	{
-		GThreadPool->AddQueuedWork(Command);
 		CommandQueue.Add({Command, bAutoDelete});
 		return ECommandResult::Succeeded;
 	}
 	else // fall back to synchronous execution
 	{
 		Command->DoWork();
-		Command->UpdateStates();
+		TArray<FPathId> ChangedFiles;
+		if (Command->UpdateStates(ChangedFiles))
+		{
+			BroadcastStateChanged(ChangedFiles);
+		}
 		LogErrors(Command->ErrorMessages);
 		Command->NotifyOperationComplete();
 		
@@ -439,6 +795,30 @@ ECommandResult::Type FProvider::ExecuteCommand(FCommand* Command, bool bAutoDele
 	}
 }
 
+ECommandLane FProvider::GetCommandLane(
+	const FCommand& InCommand, EConcurrency::Type InConcurrency
+)
+{
+	// the editor is blocked while synchronous commands execute, so they always take priority
+	if (InConcurrency == EConcurrency::Synchronous)
+	{
+		return ECommandLane::Interactive;
+	}
+
+	// asynchronous status updates are usually the editor refreshing its caches, 
+	// unless history was requested, in which case there's a user looking at a history dialog
+	if (InCommand.GetOperation()->GetName() == OperationNames::UpdateStatus)
+	{
+		auto Operation = StaticCastSharedRef<FUpdateStatus>(InCommand.GetOperation());
+		if (!Operation->ShouldUpdateHistory())
+		{
+			return ECommandLane::Background;
+		}
+	}
+
+	return ECommandLane::UserVisible;
+}
+
 FWorkerPtr FProvider::CreateWorker(const FName& InOperationName) const
 {
 	const auto* CreateWorkerPtr = WorkerCreatorsMap.Find(InOperationName);
@@ -497,32 +877,32 @@ void FProvider::PrepareFilenamesForAddCommand(
 		AssetRegistryModule.Get().GetAssets(LargeAssetFilter, LargeAssets);
 
 		// convert the long package names of all matching assets back to filenames
+		TSet<FString> LargeFileSet;
+		LargeFileSet.Reserve(LargeAssets.Num());
 		for (const auto& Asset : LargeAssets)
 		{
 			FString RelativePath = FPackageName::LongPackageNameToFilename(
 				Asset.PackageName.ToString(), FPackageName::GetAssetPackageExtension()
 			);
-			OutAbsoluteLargeFiles.Add(
-				FPaths::ConvertRelativePathToFull(RelativePath)
-			);
+			FString FullPath = PathNormalizer.ToAbsolute(RelativePath);
+			OutAbsoluteLargeFiles.Add(FullPath);
+			LargeFileSet.Add(MoveTemp(FullPath));
 		}
 
 		// any input file that didn't match the asset filter will be added with no special flags
-		for (const auto& Filename : InFiles)
+		TArray<FString> AbsoluteFiles;
+		PathNormalizer.ToAbsolute(InFiles, AbsoluteFiles);
+		for (auto& FullPath : AbsoluteFiles)
 		{
-			FString FullPath(FPaths::ConvertRelativePathToFull(Filename));
-			if (!OutAbsoluteLargeFiles.Contains(FullPath))
+			if (!LargeFileSet.Contains(FullPath))
 			{
-				OutAbsoluteFiles.Add(FullPath);
+				OutAbsoluteFiles.Add(MoveTemp(FullPath));
 			}
 		}
 	}
 	else
 	{
-		for (const auto& Filename : InFiles)
-		{
-			OutAbsoluteFiles.Add(FPaths::ConvertRelativePathToFull(Filename));
-		}
+		PathNormalizer.ToAbsolute(InFiles, OutAbsoluteFiles);
 	}
 }
 
@@ -530,16 +910,37 @@ TArray<FSourceControlStateRef> FProvider::GetCachedStateByPredicate(
 	TFunctionRef<bool(const FSourceControlStateRef&)> Predicate
 ) const
 {
-	TArray<FSourceControlStateRef> MatchingFileStates;
-	for (const auto& FileStateMapEntry : FileStateMap)
-	{
-		auto FileState = FileStateMapEntry.Value;
-		if (Predicate(FileState))
+	// the predicate is opaque, so every state has to be passed to it, queries by status should 
+	// use GetCachedStatesWithStatus() instead
+	TArray<FFileStateRef> MatchingFileStates;
+	FileStateCache.GetStatesByPredicate(
+		[&Predicate](const FFileStateRef& FileState)
 		{
-			MatchingFileStates.Add(FileState);
-		}
+			return Predicate(FileState);
+		},
+		MatchingFileStates
+	);
+	return TArray<FSourceControlStateRef>(MatchingFileStates);
+}
+
+TArray<FSourceControlStateRef> FProvider::GetCachedStatesWithStatus(
+	const TArray<EFileStatus>& InStatuses
+) const
+{
+	TArray<FFileStateRef> MatchingFileStates;
+	FileStateCache.GetStatesWithStatus(InStatuses, MatchingFileStates);
+	return TArray<FSourceControlStateRef>(MatchingFileStates);
+}
+
+FDirectoryStatus FProvider::GetDirectoryStatus(const FString& InDirectory) const
+{
+	// a directory that was never interned can't contain any cached states
+	const FPathId DirectoryId = FPathTable::Get().Find(PathNormalizer.ToAbsolute(InDirectory));
+	if (DirectoryId == INDEX_NONE)
+	{
+		return FDirectoryStatus();
 	}
-	return MatchingFileStates;
+	return FileStateCache.GetDirectoryStatus(DirectoryId);
 }
 
 #undef LOCTEXT_NAMESPACE
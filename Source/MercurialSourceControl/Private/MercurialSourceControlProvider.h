@@ -26,12 +26,23 @@
 #include "ISourceControlProvider.h"
 #include "IMercurialSourceControlWorker.h"
 #include "MercurialSourceControlFileState.h"
+#include "MercurialSourceControlFileStateCache.h"
 #include "MercurialSourceControlProviderSettings.h"
+#include "MercurialSourceControlThreadPool.h"
+#include "MercurialSourceControlScheduler.h"
+#include "MercurialSourceControlPathNormalizer.h"
+#include "MercurialSourceControlMutationJournal.h"
 
 namespace MercurialSourceControl {
 
 DECLARE_DELEGATE_RetVal(FWorkerRef, FCreateWorkerDelegate)
 
+/** 
+ * Delegate called when the states of specific files change.
+ * @param ChangedFiles Absolute filenames of the files whose states changed.
+ */
+DECLARE_MULTICAST_DELEGATE_OneParam(FFileStatesChanged, const TArray<FString>& /*ChangedFiles*/)
+
 class FCommand;
 
 /** 
@@ -109,7 +120,13 @@ public:
 #endif // SOURCE_CONTROL_WITH_SLATE
 
 public:
-	FProvider() : ProviderName("Mercurial") {}
+	FProvider() 
+		: Scheduler(ThreadPool)
+		, VerificationTime(0.0)
+		, JournalFlushTime(0.0)
+		, ProviderName("Mercurial") 
+	{
+	}
 
 	/**
 	 * Register a delegate that creates a worker.
@@ -119,12 +136,53 @@ public:
 	 */
 	void RegisterWorkerCreator(const FName& InOperationName, const FCreateWorkerDelegate& InDelegate);
 
-	/** Update the file status cache with the content of the given file states. */
+	/** 
+	 * Update the file status cache with the content of the given file states.
+	 * @note Workers should publish states via FCommand::GetFileStateCache() instead.
+	 */
 	bool UpdateFileStateCache(const TArray<FFileState>& InStates);
 
-	/** Update the file status cache with the content of the given file revisions. */
+	/** 
+	 * Update the file status cache with the content of the given file revisions.
+	 * @note Workers should publish states via FCommand::GetFileStateCache() instead.
+	 */
 	bool UpdateFileStateCache(const TMap<FString, TArray<FFileRevisionRef> >& InFileRevisionsMap);
 
+	/**
+	 * Queue a background status update for the given files.
+	 * Used by workers that predict the states of the files they've mutated instead of asking hg,
+	 * the status update is delayed a little so that bursts of mutations are verified together.
+	 * @note Must be called on the main thread.
+	 */
+	void VerifyStatesLater(const TArray<FPathId>& InFiles);
+
+	/**
+	 * Register a delegate to be called when the states of specific files change.
+	 * Unlike OnSourceControlStateChanged this passes in the files that actually changed, so 
+	 * listeners can refresh only the affected items. Changes that can't be narrowed down to 
+	 * specific files (e.g. connecting to a different repository) are only broadcast through 
+	 * OnSourceControlStateChanged.
+	 */
+	FDelegateHandle RegisterFileStatesChanged_Handle(const FFileStatesChanged::FDelegate& InDelegate);
+	void UnregisterFileStatesChanged_Handle(FDelegateHandle Handle);
+
+	/**
+	 * Get all the cached states whose status matches one of the given statuses.
+	 * This is far cheaper than GetCachedStateByPredicate() for common queries like 
+	 * "all modified files" because it only touches the matching states.
+	 */
+	TArray<FSourceControlStateRef> GetCachedStatesWithStatus(
+		const TArray<EFileStatus>& InStatuses
+	) const;
+
+	/**
+	 * Get the number of modified, added, removed, untracked and missing files within the given 
+	 * directory (including subdirectories) based on the cached states, e.g. to decorate a 
+	 * content browser folder. This takes constant time regardless of the size of the directory.
+	 * @param InDirectory Absolute path, or path relative to the project directory.
+	 */
+	FDirectoryStatus GetDirectoryStatus(const FString& InDirectory) const;
+
 	static void LogError(const FText& InErrorMessage);
 	static void LogErrors(const TArray<FString>& ErrorMessages);
 
@@ -153,10 +211,44 @@ public:
 		
 private:
 	/** 
-	 * Attempt to retrieve the state of the given file from the cache, if that fails create a 
-	 * default state for the file. 
+	 * Check if the given command can still be cancelled. Commands that modify the repository 
+	 * can only be cancelled until they start executing, stopping hg part way through could 
+	 * leave the repository in need of recovery.
 	 */
-	FFileStateRef GetFileStateFromCache(const FString& Filename);
+	static bool CanCancelCommand(const FCommand& InCommand);
+
+	/** Check if the given command only reads, and so can be stopped while it's executing. */
+	static bool IsInterruptibleCommand(const FCommand& InCommand);
+
+	/** 
+	 * Create a command to perform the given operation on the given files, and execute it.
+	 * @param InAbsoluteFiles Normalized absolute filenames.
+	 * @param InAbsoluteLargeFiles Normalized absolute filenames of files that should be flagged
+	 *                             as large (only used by the MarkForAdd operation).
+	 */
+	ECommandResult::Type ExecuteForFiles(
+		const TSharedRef<ISourceControlOperation, ESPMode::ThreadSafe>& InOperation,
+		const TArray<FString>& InAbsoluteFiles, const TArray<FString>& InAbsoluteLargeFiles,
+		EConcurrency::Type InConcurrency,
+		const FSourceControlOperationComplete& InOperationCompleteDelegate
+	);
+
+	/**
+	 * Record the given operation in the mutation journal instead of executing it.
+	 * The delegate will be called with the actual result once the journal has been flushed.
+	 * @return false if the operation can't be journaled, in which case it should be executed.
+	 */
+	bool JournalMutation(
+		const TSharedRef<ISourceControlOperation, ESPMode::ThreadSafe>& InOperation,
+		const TArray<FString>& InAbsoluteFiles, const TArray<FString>& InAbsoluteLargeFiles,
+		const FSourceControlOperationComplete& InOperationCompleteDelegate
+	);
+
+	/** 
+	 * Execute all the mutations recorded in the mutation journal, the operations that were 
+	 * journaled will be completed with the results of the commands they were merged into.
+	 */
+	void FlushMutationJournal(EConcurrency::Type InConcurrency = EConcurrency::Asynchronous);
 
 	/** 
 	 * Execute a command synchronously.
@@ -168,10 +260,23 @@ private:
 	/** 
 	 * Execute a command asynchronously if possible, 
 	 * fall back to synchronous execution if necessary.
+	 * @param InConcurrency Concurrency the command was requested with, used to decide which
+	 *                      lane of the thread pool the command should be queued in.
 	 * @param bAutoDelete If true the command will be deleted after it finishes executing,
 	 *                    assuming it's executed asynchronously this will happen in Tick().
 	 */
-	ECommandResult::Type ExecuteCommand(FCommand* Command, bool bAutoDelete);
+	ECommandResult::Type ExecuteCommand(
+		FCommand* Command, EConcurrency::Type InConcurrency, bool bAutoDelete
+	);
+
+	/** 
+	 * Notify listeners that states have changed.
+	 * @param InChangedFiles The IDs of the files whose states changed, may contain duplicates.
+	 */
+	void BroadcastStateChanged(const TArray<FPathId>& InChangedFiles);
+
+	/** Decide which thread pool lane the given command should be executed in. */
+	static ECommandLane GetCommandLane(const FCommand& InCommand, EConcurrency::Type InConcurrency);
 
 	/** 
 	 * Attempt to create a worker to perform the named operation, 
@@ -205,12 +310,70 @@ private:
 	/** Queue of commands given by the main thread. */
 	TArray<FCommandQueueEntry> CommandQueue;
 
-	/** Cache of file states. */
-	TMap<FString, FFileStateRef> FileStateMap;
+	/** Threads that commands are executed on, kept separate from GThreadPool. */
+	FCommandThreadPool ThreadPool;
+
+	/** Orders commands that touch the same files before they're handed to ThreadPool. */
+	FCommandScheduler Scheduler;
+
+	/** Cache of file states, workers update it directly from their own threads. */
+	FFileStateCache FileStateCache;
+
+	/** Converts the filenames passed in by the editor to absolute filenames. */
+	FPathNormalizer PathNormalizer;
 
 	/** Used to notify when the state of an item (or group of items) has changed. */
 	FSourceControlStateChanged OnSourceControlStateChanged;
 
+	/** Used to notify when the states of specific files have changed. */
+	FFileStatesChanged OnFileStatesChanged;
+
+	/** 
+	 * IDs of files changed via UpdateFileStateCache() that listeners haven't been notified 
+	 * about yet, they'll be notified on the next Tick().
+	 */
+	TArray<FPathId> PendingChangedFiles;
+
+	/** IDs of files whose predicted states haven't been verified yet. */
+	TSet<FPathId> UnverifiedFiles;
+
+	/** Time (in seconds) at which the states of UnverifiedFiles should be verified. */
+	double VerificationTime;
+
+	/** Adds, deletes, and reverts that haven't been executed yet. */
+	FMutationJournal MutationJournal;
+
+	/** An operation that was recorded in the mutation journal instead of being executed. */
+	struct FJournaledOperation
+	{
+		TSharedRef<ISourceControlOperation, ESPMode::ThreadSafe> Operation;
+		FSourceControlOperationComplete OperationCompleteDelegate;
+		/** Number of flushed commands the operation's files were merged into that are running. */
+		int32 NumPendingCommands;
+		/** Combined result of the flushed commands that have completed so far. */
+		ECommandResult::Type Result;
+
+		FJournaledOperation(
+			const TSharedRef<ISourceControlOperation, ESPMode::ThreadSafe>& InOperation,
+			const FSourceControlOperationComplete& InOperationCompleteDelegate
+		)
+			: Operation(InOperation)
+			, OperationCompleteDelegate(InOperationCompleteDelegate)
+			, NumPendingCommands(0)
+			, Result(ECommandResult::Succeeded)
+		{
+		}
+	};
+
+	/** 
+	 * Operations recorded in MutationJournal, the journal identifies each operation by its 
+	 * index in this array.
+	 */
+	TArray<TSharedRef<FJournaledOperation>> JournaledOperations;
+
+	/** Time (in seconds) at which MutationJournal should be flushed. */
+	double JournalFlushTime;
+
 	/** Absolute path to the current project's content directory. */
 	FString AbsoluteContentDirectory;
 
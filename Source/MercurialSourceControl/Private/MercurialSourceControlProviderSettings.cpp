@@ -33,8 +33,52 @@ namespace Settings {
 	const TCHAR* MercurialPath = TEXT("MercurialPath");
 	const TCHAR* LargefilesIntegration = TEXT("LargefilesIntegration");
 	const TCHAR* LargeAssetTypes = TEXT("LargeAssetTypes");
+	const TCHAR* LaneThreadCounts[] = {
+		TEXT("InteractiveThreads"),
+		TEXT("UserVisibleThreads"),
+		TEXT("BackgroundThreads"),
+	};
+	static_assert(
+		ARRAY_COUNT(LaneThreadCounts) == (int32)ECommandLane::Count, 
+		"Every command lane needs a setting."
+	);
+	const TCHAR* MutationJournal = TEXT("MutationJournal");
+	const TCHAR* TrustedExecutable = TEXT("TrustedExecutable");
+	const TCHAR* TrustedExecutableSize = TEXT("TrustedExecutableSize");
+	const TCHAR* TrustedExecutableTimeStamp = TEXT("TrustedExecutableTimeStamp");
+	const TCHAR* FastProfile = TEXT("FastProfile");
+	const TCHAR* Chg = TEXT("Chg");
+	const TCHAR* ReadTimeout = TEXT("ReadTimeout");
+	const TCHAR* WriteTimeout = TEXT("WriteTimeout");
+	const TCHAR* LockTimeout = TEXT("LockTimeout");
+	const TCHAR* LockRetries = TEXT("LockRetries");
+	const TCHAR* LockRetryDelay = TEXT("LockRetryDelay");
 } // namespace Settings
 
+FExecutableFingerprint FExecutableFingerprint::FromFile(const FString& InFilename)
+{
+	FExecutableFingerprint Fingerprint;
+	const FFileStatData StatData = IFileManager::Get().GetStatData(*InFilename);
+	if (StatData.bIsValid && !StatData.bIsDirectory)
+	{
+		Fingerprint.Filename = InFilename;
+		Fingerprint.Size = StatData.FileSize;
+		Fingerprint.TimeStamp = StatData.ModificationTime;
+	}
+	return Fingerprint;
+}
+
+FProviderSettings::FProviderSettings()
+	: bEnableLargefilesIntegration(false)
+	, bEnableMutationJournal(true)
+	, bEnableFastProfile(true)
+	, bEnableChg(true)
+{
+	LaneThreadCounts[(int32)ECommandLane::Interactive] = 2;
+	LaneThreadCounts[(int32)ECommandLane::UserVisible] = 2;
+	LaneThreadCounts[(int32)ECommandLane::Background] = 1;
+}
+
 
 const FString& FProviderSettings::GetMercurialPath() const
 {
@@ -72,6 +116,78 @@ void FProviderSettings::SetLargeAssetTypes(const TArray<FString>& InLargeAssetTy
 	LargeAssetTypes = InLargeAssetTypes;
 }
 
+int32 FProviderSettings::GetLaneThreadCount(ECommandLane InLane) const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	return LaneThreadCounts[(int32)InLane];
+}
+
+void FProviderSettings::SetLaneThreadCount(ECommandLane InLane, int32 InThreadCount)
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	LaneThreadCounts[(int32)InLane] = InThreadCount;
+}
+
+bool FProviderSettings::IsMutationJournalEnabled() const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	return bEnableMutationJournal;
+}
+
+void FProviderSettings::EnableMutationJournal(bool bEnable)
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	bEnableMutationJournal = bEnable;
+}
+
+FExecutableFingerprint FProviderSettings::GetTrustedExecutable() const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	return TrustedExecutable;
+}
+
+void FProviderSettings::SetTrustedExecutable(const FExecutableFingerprint& InExecutable)
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	TrustedExecutable = InExecutable;
+}
+
+bool FProviderSettings::IsFastProfileEnabled() const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	return bEnableFastProfile;
+}
+
+void FProviderSettings::EnableFastProfile(bool bEnable)
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	bEnableFastProfile = bEnable;
+}
+
+bool FProviderSettings::IsChgEnabled() const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	return bEnableChg;
+}
+
+void FProviderSettings::EnableChg(bool bEnable)
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	bEnableChg = bEnable;
+}
+
+FTimeoutPolicy FProviderSettings::GetTimeoutPolicy() const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	return TimeoutPolicy;
+}
+
+void FProviderSettings::SetTimeoutPolicy(const FTimeoutPolicy& InTimeoutPolicy)
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	TimeoutPolicy = InTimeoutPolicy;
+}
+
 void FProviderSettings::Save()
 {
 	FScopeLock ScopeLock(&CriticalSection);
@@ -81,6 +197,22 @@ void FProviderSettings::Save()
 		GConfig->SetString(Settings::Section, Settings::MercurialPath, *MercurialPath, SettingsFile);
 		GConfig->SetBool(Settings::Section, Settings::LargefilesIntegration, bEnableLargefilesIntegration, SettingsFile);
 		GConfig->SetArray(Settings::Section, Settings::LargeAssetTypes, LargeAssetTypes, SettingsFile);
+		for (int32 i = 0; i < (int32)ECommandLane::Count; ++i)
+		{
+			GConfig->SetInt(Settings::Section, Settings::LaneThreadCounts[i], LaneThreadCounts[i], SettingsFile);
+		}
+		GConfig->SetBool(Settings::Section, Settings::MutationJournal, bEnableMutationJournal, SettingsFile);
+		// GConfig has no 64-bit integer accessors
+		GConfig->SetString(Settings::Section, Settings::TrustedExecutable, *TrustedExecutable.Filename, SettingsFile);
+		GConfig->SetString(Settings::Section, Settings::TrustedExecutableSize, *LexToString(TrustedExecutable.Size), SettingsFile);
+		GConfig->SetString(Settings::Section, Settings::TrustedExecutableTimeStamp, *LexToString(TrustedExecutable.TimeStamp.GetTicks()), SettingsFile);
+		GConfig->SetBool(Settings::Section, Settings::FastProfile, bEnableFastProfile, SettingsFile);
+		GConfig->SetBool(Settings::Section, Settings::Chg, bEnableChg, SettingsFile);
+		GConfig->SetFloat(Settings::Section, Settings::ReadTimeout, TimeoutPolicy.ReadTimeout, SettingsFile);
+		GConfig->SetFloat(Settings::Section, Settings::WriteTimeout, TimeoutPolicy.WriteTimeout, SettingsFile);
+		GConfig->SetInt(Settings::Section, Settings::LockTimeout, TimeoutPolicy.LockTimeout, SettingsFile);
+		GConfig->SetInt(Settings::Section, Settings::LockRetries, TimeoutPolicy.LockRetries, SettingsFile);
+		GConfig->SetFloat(Settings::Section, Settings::LockRetryDelay, TimeoutPolicy.LockRetryDelay, SettingsFile);
 	}
 }
 
@@ -93,6 +225,31 @@ void FProviderSettings::Load()
 		GConfig->GetString(Settings::Section, Settings::MercurialPath, MercurialPath, SettingsFile);
 		GConfig->GetBool(Settings::Section, Settings::LargefilesIntegration, bEnableLargefilesIntegration, SettingsFile);
 		GConfig->GetArray(Settings::Section, Settings::LargeAssetTypes, LargeAssetTypes, SettingsFile);
+		for (int32 i = 0; i < (int32)ECommandLane::Count; ++i)
+		{
+			GConfig->GetInt(Settings::Section, Settings::LaneThreadCounts[i], LaneThreadCounts[i], SettingsFile);
+		}
+		GConfig->GetBool(Settings::Section, Settings::MutationJournal, bEnableMutationJournal, SettingsFile);
+		FString Size;
+		FString TimeStamp;
+		if (GConfig->GetString(Settings::Section, Settings::TrustedExecutable, TrustedExecutable.Filename, SettingsFile) &&
+			GConfig->GetString(Settings::Section, Settings::TrustedExecutableSize, Size, SettingsFile) &&
+			GConfig->GetString(Settings::Section, Settings::TrustedExecutableTimeStamp, TimeStamp, SettingsFile))
+		{
+			TrustedExecutable.Size = FCString::Atoi64(*Size);
+			TrustedExecutable.TimeStamp = FDateTime(FCString::Atoi64(*TimeStamp));
+		}
+		else
+		{
+			TrustedExecutable = FExecutableFingerprint();
+		}
+		GConfig->GetBool(Settings::Section, Settings::FastProfile, bEnableFastProfile, SettingsFile);
+		GConfig->GetBool(Settings::Section, Settings::Chg, bEnableChg, SettingsFile);
+		GConfig->GetFloat(Settings::Section, Settings::ReadTimeout, TimeoutPolicy.ReadTimeout, SettingsFile);
+		GConfig->GetFloat(Settings::Section, Settings::WriteTimeout, TimeoutPolicy.WriteTimeout, SettingsFile);
+		GConfig->GetInt(Settings::Section, Settings::LockTimeout, TimeoutPolicy.LockTimeout, SettingsFile);
+		GConfig->GetInt(Settings::Section, Settings::LockRetries, TimeoutPolicy.LockRetries, SettingsFile);
+		GConfig->GetFloat(Settings::Section, Settings::LockRetryDelay, TimeoutPolicy.LockRetryDelay, SettingsFile);
 	}
 }
 
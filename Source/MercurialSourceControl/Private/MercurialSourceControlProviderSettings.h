@@ -24,18 +24,90 @@
 
 #pragma once
 
+#include "MercurialSourceControlThreadPool.h"
+
 namespace MercurialSourceControl {
 
+/** Identifies a particular build of an executable by its filename, size, and timestamp. */
+struct FExecutableFingerprint
+{
+	FString Filename;
+	int64 Size;
+	FDateTime TimeStamp;
+
+	FExecutableFingerprint() : Size(-1) {}
+
+	/** Fingerprint the given file, the result will be invalid if the file doesn't exist. */
+	static FExecutableFingerprint FromFile(const FString& InFilename);
+
+	bool IsValid() const
+	{
+		return Size >= 0;
+	}
+
+	bool operator==(const FExecutableFingerprint& Other) const
+	{
+		return (Size == Other.Size) && (TimeStamp == Other.TimeStamp) 
+			&& (Filename == Other.Filename);
+	}
+
+	bool operator!=(const FExecutableFingerprint& Other) const
+	{
+		return !(*this == Other);
+	}
+};
+
+/** Limits on how long hg may run for, and how to deal with a locked repository. */
+struct FTimeoutPolicy
+{
+	/** Seconds a read-only command (e.g. status or log) may run for, zero for no limit. */
+	float ReadTimeout;
+	/** 
+	 * Seconds a command that modifies the repository may run for before it's interrupted, zero 
+	 * for no limit. Unlike read-only commands these are never killed if they don't stop.
+	 */
+	float WriteTimeout;
+	/** Seconds hg should wait for a repository lock held by another process before giving up. */
+	int32 LockTimeout;
+	/** Number of times a command that gave up waiting for a lock should be retried. */
+	int32 LockRetries;
+	/** Seconds to wait before the first retry, the delay doubles with each retry. */
+	float LockRetryDelay;
+
+	FTimeoutPolicy()
+	: ReadTimeout(300.0f)
+	, WriteTimeout(1800.0f)
+	, LockTimeout(15)
+	, LockRetries(3)
+	, LockRetryDelay(1.0f)
+	{
+	}
+};
+
 /** Provides access to settings stored in SourceControlSettings.ini. */
 class FProviderSettings
 {
 public:
+	FProviderSettings();
+
 	const FString& GetMercurialPath() const;
 	void SetMercurialPath(const FString& InMercurialPath);
 	bool IsLargefilesIntegrationEnabled() const;
 	void EnableLargefilesIntegration(bool bEnable);
 	void GetLargeAssetTypes(TArray<FString>& OutLargeAssetTypes) const;
 	void SetLargeAssetTypes(const TArray<FString>& InLargeAssetTypes);
+	int32 GetLaneThreadCount(ECommandLane InLane) const;
+	void SetLaneThreadCount(ECommandLane InLane, int32 InThreadCount);
+	bool IsMutationJournalEnabled() const;
+	void EnableMutationJournal(bool bEnable);
+	FExecutableFingerprint GetTrustedExecutable() const;
+	void SetTrustedExecutable(const FExecutableFingerprint& InExecutable);
+	bool IsFastProfileEnabled() const;
+	void EnableFastProfile(bool bEnable);
+	bool IsChgEnabled() const;
+	void EnableChg(bool bEnable);
+	FTimeoutPolicy GetTimeoutPolicy() const;
+	void SetTimeoutPolicy(const FTimeoutPolicy& InTimeoutPolicy);
 
 	void Save();
 	void Load();
@@ -53,6 +125,39 @@ private:
 		extension.
 	*/
 	TArray<FString> LargeAssetTypes;
+
+	/** 
+		Number of threads to create for each command lane, changes take effect the next time
+		the provider is initialized.
+	*/
+	int32 LaneThreadCounts[(int32)ECommandLane::Count];
+
+	/** 
+		If true adds, deletes, and reverts are deferred for a short while so they can be 
+		merged into fewer hg invocations.
+	*/
+	bool bEnableMutationJournal;
+
+	/** 
+		The Mercurial executable that was last successfully validated, there's no need to 
+		validate it again unless it changes.
+	*/
+	FExecutableFingerprint TrustedExecutable;
+
+	/** 
+		If true hg is run with HGPLAIN set and with extensions the plugin doesn't need disabled,
+		changes take effect the next time the provider connects.
+	*/
+	bool bEnableFastProfile;
+
+	/** 
+		If true hg is run through chg (if it can be found) to avoid paying the Python startup 
+		cost for every command, changes take effect the next time the provider connects.
+	*/
+	bool bEnableChg;
+
+	/** Changes take effect the next time the provider connects. */
+	FTimeoutPolicy TimeoutPolicy;
 };
 
 } // namespace MercurialSourceControl
@@ -0,0 +1,347 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlScheduler.h"
+#include "MercurialSourceControlCommand.h"
+#include "MercurialSourceControlOperationNames.h"
+#include "SourceControlOperations.h"
+
+namespace MercurialSourceControl {
+
+FCommandScheduler::FCommandScheduler(FCommandThreadPool& InThreadPool)
+	: ThreadPool(InThreadPool)
+	, bIsShuttingDown(false)
+{
+}
+
+bool FCommandScheduler::Submit(FCommand* InCommand, ECommandLane InLane)
+{
+	FScopeLock ScopeLock(&CriticalSection);
+
+	if (bIsShuttingDown || (!ThreadPool.IsValid() && !GThreadPool))
+	{
+		return false;
+	}
+
+	FEntry Entry;
+	Entry.Command = InCommand;
+	Entry.Lane = InLane;
+	GetPathClaims(*InCommand, Entry.Claims);
+
+	InCommand->SetScheduler(this);
+
+	// a command can only go ahead of the pending commands it doesn't conflict with
+	bool bCanDispatch = !ConflictsWithRunning(Entry.Claims);
+	for (int32 i = 0; bCanDispatch && (i < PendingCommands.Num()); ++i)
+	{
+		bCanDispatch = !DoClaimsConflict(PendingCommands[i].Claims, Entry.Claims);
+	}
+
+	if (bCanDispatch)
+	{
+		RunningCommands.Add(MoveTemp(Entry));
+		Dispatch(InCommand, InLane);
+	}
+	else
+	{
+		PendingCommands.Add(MoveTemp(Entry));
+	}
+	return true;
+}
+
+void FCommandScheduler::OnCommandFinished(FCommand* InCommand)
+{
+	FScopeLock ScopeLock(&CriticalSection);
+
+	RunningCommands.RemoveAll([InCommand](const FEntry& Entry)
+	{
+		return Entry.Command == InCommand;
+	});
+
+	if (bIsShuttingDown)
+	{
+		return;
+	}
+
+	// dispatch all the pending commands that no longer conflict with anything that was 
+	// submitted before them
+	for (int32 i = 0; i < PendingCommands.Num();)
+	{
+		bool bCanDispatch = !ConflictsWithRunning(PendingCommands[i].Claims);
+		for (int32 j = 0; bCanDispatch && (j < i); ++j)
+		{
+			bCanDispatch = !DoClaimsConflict(PendingCommands[j].Claims, PendingCommands[i].Claims);
+		}
+
+		if (bCanDispatch)
+		{
+			FCommand* Command = PendingCommands[i].Command;
+			const ECommandLane Lane = PendingCommands[i].Lane;
+			RunningCommands.Add(MoveTemp(PendingCommands[i]));
+			PendingCommands.RemoveAt(i);
+			Dispatch(Command, Lane);
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+bool FCommandScheduler::Cancel(FCommand* InCommand)
+{
+	{
+		FScopeLock ScopeLock(&CriticalSection);
+
+		const int32 PendingIndex = PendingCommands.IndexOfByPredicate(
+			[InCommand](const FEntry& Entry)
+			{
+				return Entry.Command == InCommand;
+			}
+		);
+
+		if (PendingIndex != INDEX_NONE)
+		{
+			PendingCommands.RemoveAt(PendingIndex);
+		}
+		else
+		{
+			const FEntry* RunningEntry = RunningCommands.FindByPredicate(
+				[InCommand](const FEntry& Entry)
+				{
+					return Entry.Command == InCommand;
+				}
+			);
+
+			// the command may still be sitting in a thread pool queue
+			const bool bRetracted = RunningEntry && 
+				(ThreadPool.RetractQueuedWork(InCommand, RunningEntry->Lane) ||
+				(GThreadPool && GThreadPool->RetractQueuedWork(InCommand)));
+
+			if (!bRetracted)
+			{
+				return false;
+			}
+		}
+	}
+
+	// this will call OnCommandFinished(), which will dispatch anything that was waiting on it
+	InCommand->Abandon();
+	return true;
+}
+
+void FCommandScheduler::Shutdown()
+{
+	TArray<FCommand*> AbandonedCommands;
+	TArray<FCommand*> StartedCommands;
+	{
+		FScopeLock ScopeLock(&CriticalSection);
+		bIsShuttingDown = true;
+		for (const auto& Entry : PendingCommands)
+		{
+			AbandonedCommands.Add(Entry.Command);
+		}
+		PendingCommands.Reset();
+
+		// pull back anything that's still sitting in a thread pool queue
+		for (const auto& Entry : RunningCommands)
+		{
+			const bool bRetracted = 
+				ThreadPool.RetractQueuedWork(Entry.Command, Entry.Lane) ||
+				(GThreadPool && GThreadPool->RetractQueuedWork(Entry.Command));
+
+			if (bRetracted)
+			{
+				AbandonedCommands.Add(Entry.Command);
+			}
+			else
+			{
+				StartedCommands.Add(Entry.Command);
+			}
+		}
+	}
+
+	for (FCommand* Command : AbandonedCommands)
+	{
+		Command->Cancel();
+		Command->Abandon();
+	}
+
+	// nothing else will wait for the commands running on the shared thread pool before 
+	// they're deleted
+	for (FCommand* Command : StartedCommands)
+	{
+		while (!Command->HasExecuted())
+		{
+			Command->WaitForCompletion(MAX_uint32);
+		}
+	}
+}
+
+void FCommandScheduler::Startup()
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	bIsShuttingDown = false;
+}
+
+void FCommandScheduler::GetPathClaims(const FCommand& InCommand, FPathClaims& OutClaims)
+{
+	const FName OperationName = InCommand.GetOperation()->GetName();
+
+	if (OperationName == OperationNames::UpdateStatus)
+	{
+		OutClaims.bWrites = false;
+		OutClaims.Files.Append(InCommand.GetAbsoluteFiles());
+
+		auto Operation = StaticCastSharedRef<FUpdateStatus>(InCommand.GetOperation());
+		if (Operation->ShouldGetOpenedOnly())
+		{
+			FString Directory = InCommand.GetContentDirectory();
+			if (!Directory.EndsWith(TEXT("/")))
+			{
+				Directory += TEXT("/");
+			}
+			OutClaims.Directories.Add(Directory);
+		}
+	}
+	else if ((OperationName == OperationNames::Revert)
+		|| (OperationName == OperationNames::Delete)
+		|| (OperationName == OperationNames::MarkForAdd)
+		|| (OperationName == OperationNames::CheckIn))
+	{
+		OutClaims.bWrites = true;
+		OutClaims.Files.Append(InCommand.GetAbsoluteFiles());
+		OutClaims.Files.Append(InCommand.GetAbsoluteLargeFiles());
+		// an operation with no files (e.g. committing everything) affects the whole repository
+		OutClaims.bExclusive = (OutClaims.Files.Num() == 0);
+	}
+	else
+	{
+		// connecting (or anything we don't know about) shouldn't overlap with anything else
+		OutClaims.bWrites = true;
+		OutClaims.bExclusive = true;
+	}
+}
+
+bool FCommandScheduler::DoClaimsConflict(const FPathClaims& A, const FPathClaims& B)
+{
+	if (A.bExclusive || B.bExclusive)
+	{
+		return true;
+	}
+
+	// reads never conflict with other reads
+	if (!A.bWrites && !B.bWrites)
+	{
+		return false;
+	}
+
+	return DoPathsOverlap(A, B);
+}
+
+bool FCommandScheduler::DoPathsOverlap(const FPathClaims& A, const FPathClaims& B)
+{
+	// look up the filenames of the smaller set in the larger one
+	const auto& SmallerFiles = (A.Files.Num() < B.Files.Num()) ? A.Files : B.Files;
+	const auto& LargerFiles = (A.Files.Num() < B.Files.Num()) ? B.Files : A.Files;
+	for (const auto& Filename : SmallerFiles)
+	{
+		if (LargerFiles.Contains(Filename))
+		{
+			return true;
+		}
+	}
+
+	auto IsInDirectories = [](const FString& InPath, const TArray<FString>& InDirectories)
+	{
+		for (const auto& Directory : InDirectories)
+		{
+			if (InPath.StartsWith(Directory))
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	// directories are rare (and few), so scanning for them is cheap enough
+	if (B.Directories.Num() > 0)
+	{
+		for (const auto& Path : A.Files)
+		{
+			if (IsInDirectories(Path, B.Directories))
+			{
+				return true;
+			}
+		}
+	}
+
+	if (A.Directories.Num() > 0)
+	{
+		for (const auto& Path : B.Files)
+		{
+			if (IsInDirectories(Path, A.Directories))
+			{
+				return true;
+			}
+		}
+	}
+
+	for (const auto& Directory : A.Directories)
+	{
+		for (const auto& OtherDirectory : B.Directories)
+		{
+			if (Directory.StartsWith(OtherDirectory) || OtherDirectory.StartsWith(Directory))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool FCommandScheduler::ConflictsWithRunning(const FPathClaims& InClaims) const
+{
+	for (const auto& Entry : RunningCommands)
+	{
+		if (DoClaimsConflict(Entry.Claims, InClaims))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void FCommandScheduler::Dispatch(FCommand* InCommand, ECommandLane InLane)
+{
+	if (!ThreadPool.AddQueuedWork(InCommand, InLane))
+	{
+		check(GThreadPool);
+		GThreadPool->AddQueuedWork(InCommand);
+	}
+}
+
+} // namespace MercurialSourceControl
@@ -0,0 +1,131 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+#include "MercurialSourceControlThreadPool.h"
+
+namespace MercurialSourceControl {
+
+class FCommand;
+
+/**
+ * Sits between the provider and the thread pool, and decides when each command can start.
+ *
+ * Every command claims the paths it reads or writes. Commands whose claims don't overlap are 
+ * dispatched to the thread pool straight away and execute in parallel, commands that only read 
+ * may overlap each other, but a command that writes to a path waits for all previously 
+ * submitted commands that touch the same path to finish (and vice versa). Conflicting commands 
+ * therefore always execute in the order they were submitted.
+ *
+ * @note Commands are submitted on the main thread, but they may finish on any thread.
+ */
+class FCommandScheduler
+{
+public:
+	FCommandScheduler(FCommandThreadPool& InThreadPool);
+
+	/** 
+	 * Queue the given command in the given lane once it no longer conflicts with any 
+	 * previously submitted command.
+	 * @return false if the command could not be queued because there are no worker threads.
+	 */
+	bool Submit(FCommand* InCommand, ECommandLane InLane);
+
+	/** 
+	 * Must be called when a command that was submitted to the scheduler finishes executing 
+	 * (or is abandoned), any commands that were waiting on it may be dispatched by this call.
+	 */
+	void OnCommandFinished(FCommand* InCommand);
+
+	/** 
+	 * Abandon the given command right away if it hasn't started executing yet, so that it stops
+	 * holding up any commands that conflict with it. A command that has already started must 
+	 * notice it's been cancelled by itself.
+	 * @return true if the command was abandoned.
+	 */
+	bool Cancel(FCommand* InCommand);
+
+	/** 
+	 * Cancel and abandon all the commands that haven't started executing yet, wait for the rest 
+	 * to finish, and stop dispatching commands until Startup() is called.
+	 * @note Must be called before the thread pool is destroyed, the shared thread pool commands 
+	 *       may have fallen back to won't wait for them.
+	 */
+	void Shutdown();
+
+	/** Allow commands to be dispatched again after a Shutdown(). */
+	void Startup();
+
+private:
+	/** The paths a command will read from or write to. */
+	struct FPathClaims
+	{
+		/** Absolute filenames. */
+		TSet<FString> Files;
+		/** Absolute directory names (ending in a '/'), everything under them is claimed. */
+		TArray<FString> Directories;
+		/** Does the command modify the claimed paths? */
+		bool bWrites;
+		/** Does the command need the whole repository to itself? */
+		bool bExclusive;
+
+		FPathClaims() : bWrites(false), bExclusive(false) {}
+	};
+
+	struct FEntry
+	{
+		FCommand* Command;
+		ECommandLane Lane;
+		FPathClaims Claims;
+	};
+
+	static void GetPathClaims(const FCommand& InCommand, FPathClaims& OutClaims);
+	static bool DoClaimsConflict(const FPathClaims& A, const FPathClaims& B);
+	static bool DoPathsOverlap(const FPathClaims& A, const FPathClaims& B);
+
+	/** Check if the given claims conflict with any running commands. */
+	bool ConflictsWithRunning(const FPathClaims& InClaims) const;
+
+	/** 
+	 * Hand the command over to the thread pool.
+	 * @note The thread pool may abandon the command right away, which modifies RunningCommands,
+	 *       so this mustn't be passed anything that refers to an entry in there.
+	 */
+	void Dispatch(FCommand* InCommand, ECommandLane InLane);
+
+private:
+	FCommandThreadPool& ThreadPool;
+
+	/** Commands that have been handed over to the thread pool. */
+	TArray<FEntry> RunningCommands;
+
+	/** Commands waiting for conflicting commands to finish, in submission order. */
+	TArray<FEntry> PendingCommands;
+
+	bool bIsShuttingDown;
+
+	mutable FCriticalSection CriticalSection;
+};
+
+} // namespace MercurialSourceControl
@@ -0,0 +1,140 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlStateTransitions.h"
+#include "MercurialSourceControlFileStateCache.h"
+
+namespace MercurialSourceControl {
+
+bool FStateTransitions::PredictStatus(
+	EFileMutation InMutation, EFileStatus InStatus, EFileStatus& OutStatus
+)
+{
+	// hg skips (with a warning) any files it can't mutate, those keep their current status
+	OutStatus = InStatus;
+
+	switch (InMutation)
+	{
+		case EFileMutation::Add:
+			switch (InStatus)
+			{
+				case EFileStatus::NotTracked:
+				case EFileStatus::Ignored:
+					OutStatus = EFileStatus::Added;
+					return true;
+				case EFileStatus::Clean:
+				case EFileStatus::Added:
+				case EFileStatus::Modified:
+				case EFileStatus::Missing:
+					return true;
+				default:
+					// a removed file is restored to clean or modified depending on its content
+					return false;
+			}
+
+		case EFileMutation::Remove:
+			switch (InStatus)
+			{
+				case EFileStatus::Clean:
+				case EFileStatus::Missing:
+					OutStatus = EFileStatus::Removed;
+					return true;
+				case EFileStatus::Removed:
+				case EFileStatus::Added:
+				case EFileStatus::Modified:
+				case EFileStatus::NotTracked:
+				case EFileStatus::Ignored:
+					return true;
+				default:
+					return false;
+			}
+
+		case EFileMutation::Revert:
+			switch (InStatus)
+			{
+				case EFileStatus::Clean:
+				case EFileStatus::Modified:
+				case EFileStatus::Removed:
+				case EFileStatus::Missing:
+					OutStatus = EFileStatus::Clean;
+					return true;
+				case EFileStatus::NotTracked:
+				case EFileStatus::Ignored:
+					return true;
+				default:
+					// a reverted add could end up not tracked or ignored
+					return false;
+			}
+
+		case EFileMutation::Commit:
+			switch (InStatus)
+			{
+				case EFileStatus::Clean:
+				case EFileStatus::Added:
+				case EFileStatus::Modified:
+					OutStatus = EFileStatus::Clean;
+					return true;
+				case EFileStatus::Removed:
+					// the file is no longer tracked, and publishing that takes it out of the 
+					// tracked manifest, which an unknown status wouldn't
+					OutStatus = EFileStatus::NotTracked;
+					return true;
+				default:
+					return false;
+			}
+	}
+	return false;
+}
+
+void FStateTransitions::PublishPredictedStates(
+	EFileMutation InMutation, const TArray<FString>& InAbsoluteFiles, 
+	FFileStateCache& InOutFileStateCache, TArray<FPathId>& OutChangedFiles, 
+	TArray<FPathId>& OutPredictedFiles, TArray<FString>& OutUnpredictableFiles
+)
+{
+	const FDateTime Now = FDateTime::Now();
+	TArray<FFileState> PredictedStates;
+	PredictedStates.Reserve(InAbsoluteFiles.Num());
+	for (const auto& Filename : InAbsoluteFiles)
+	{
+		const FFileStateRef CachedState = InOutFileStateCache.FindOrAdd(Filename);
+		EFileStatus PredictedStatus;
+		if (PredictStatus(InMutation, CachedState->GetFileStatus(), PredictedStatus))
+		{
+			FFileState PredictedState(CachedState->GetPathId());
+			PredictedState.SetFileStatus(PredictedStatus);
+			PredictedState.SetTimeStamp(Now);
+			PredictedStates.Add(PredictedState);
+			OutPredictedFiles.Add(CachedState->GetPathId());
+		}
+		else
+		{
+			OutUnpredictableFiles.Add(Filename);
+		}
+	}
+	InOutFileStateCache.Update(PredictedStates, OutChangedFiles);
+}
+
+} // namespace MercurialSourceControl
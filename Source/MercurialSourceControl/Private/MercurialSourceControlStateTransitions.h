@@ -0,0 +1,79 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+#include "MercurialSourceControlFileState.h"
+
+namespace MercurialSourceControl {
+
+class FFileStateCache;
+
+/** Operations that change the status of files in the working directory. */
+enum class EFileMutation
+{
+	/** hg add */
+	Add,
+	/** hg remove */
+	Remove,
+	/** hg revert --no-backup */
+	Revert,
+	/** hg commit */
+	Commit,
+};
+
+/**
+ * Predicts the status files will have after a mutation, based on the status they had before.
+ *
+ * This lets workers publish the new states as soon as hg has done its thing, instead of running
+ * hg status afterwards. The predictions are made from the cached states, which may be stale, 
+ * so the predicted states should be verified by a status update at some later point.
+ */
+class FStateTransitions
+{
+public:
+	/**
+	 * Predict the status of a file after a successful mutation.
+	 * @return false if the new status can't be predicted from the old status alone.
+	 */
+	static bool PredictStatus(EFileMutation InMutation, EFileStatus InStatus, EFileStatus& OutStatus);
+
+	/**
+	 * Publish the predicted states of the given files after a successful mutation.
+	 * @param InAbsoluteFiles The files that were mutated.
+	 * @param InOutFileStateCache The cache the current states are looked up in, and the 
+	 *                            predicted states are published to.
+	 * @param OutChangedFiles The IDs of the files whose status changed will be appended to this.
+	 * @param OutPredictedFiles The IDs of the files whose status was predicted will be appended 
+	 *                          to this.
+	 * @param OutUnpredictableFiles Files whose status couldn't be predicted will be appended to 
+	 *                              this, their status has to be obtained from hg.
+	 */
+	static void PublishPredictedStates(
+		EFileMutation InMutation, const TArray<FString>& InAbsoluteFiles, 
+		FFileStateCache& InOutFileStateCache, TArray<FPathId>& OutChangedFiles, 
+		TArray<FPathId>& OutPredictedFiles, TArray<FString>& OutUnpredictableFiles
+	);
+};
+
+} // namespace MercurialSourceControl
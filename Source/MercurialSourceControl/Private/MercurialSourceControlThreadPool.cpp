@@ -0,0 +1,129 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlThreadPool.h"
+#include "MercurialSourceControlProviderSettings.h"
+
+namespace MercurialSourceControl {
+
+namespace 
+{
+	// Worker threads spend most of their time waiting on hg, but parsing large XML logs
+	// needs a bit more stack than the engine's default of 32 KB.
+	const uint32 LaneStackSize = 128 * 1024;
+
+	EThreadPriority GetLanePriority(ECommandLane InLane)
+	{
+		switch (InLane)
+		{
+			case ECommandLane::Interactive:
+				return TPri_AboveNormal;
+
+			case ECommandLane::Background:
+				return TPri_BelowNormal;
+
+			default:
+				return TPri_Normal;
+		}
+	}
+} // unnamed namespace
+
+FCommandThreadPool::FCommandThreadPool()
+	: bIsValid(false)
+{
+	for (auto& Lane : Lanes)
+	{
+		Lane = nullptr;
+	}
+}
+
+FCommandThreadPool::~FCommandThreadPool()
+{
+	Destroy();
+}
+
+bool FCommandThreadPool::Create(const FProviderSettings& InSettings)
+{
+	check(!bIsValid);
+
+	bIsValid = true;
+	for (int32 LaneIndex = 0; LaneIndex < (int32)ECommandLane::Count; ++LaneIndex)
+	{
+		const auto LaneType = (ECommandLane)LaneIndex;
+		const int32 NumThreads = FMath::Max(InSettings.GetLaneThreadCount(LaneType), 1);
+
+		Lanes[LaneIndex] = FQueuedThreadPool::Allocate();
+		if (!Lanes[LaneIndex]->Create(NumThreads, LaneStackSize, GetLanePriority(LaneType)))
+		{
+			UE_LOG(
+				LogSourceControl, Error, 
+				TEXT("Failed to create %d thread(s) for Mercurial command lane %d"), 
+				NumThreads, LaneIndex
+			);
+			delete Lanes[LaneIndex];
+			Lanes[LaneIndex] = nullptr;
+			bIsValid = false;
+			break;
+		}
+	}
+
+	if (!bIsValid)
+	{
+		Destroy();
+	}
+	return bIsValid;
+}
+
+void FCommandThreadPool::Destroy()
+{
+	bIsValid = false;
+	for (auto& Lane : Lanes)
+	{
+		if (Lane)
+		{
+			Lane->Destroy();
+			delete Lane;
+			Lane = nullptr;
+		}
+	}
+}
+
+bool FCommandThreadPool::AddQueuedWork(IQueuedWork* InWork, ECommandLane InLane)
+{
+	if (!bIsValid)
+	{
+		return false;
+	}
+
+	Lanes[(int32)InLane]->AddQueuedWork(InWork);
+	return true;
+}
+
+bool FCommandThreadPool::RetractQueuedWork(IQueuedWork* InWork, ECommandLane InLane)
+{
+	return bIsValid && Lanes[(int32)InLane]->RetractQueuedWork(InWork);
+}
+
+} // namespace MercurialSourceControl
@@ -0,0 +1,95 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+namespace MercurialSourceControl {
+
+class FProviderSettings;
+
+/** 
+ * Priority lanes for source control work.
+ * Each lane is serviced by its own threads so that slow background work can't hold up 
+ * operations the user is actively waiting on.
+ */
+enum class ECommandLane
+{
+	/** Synchronous operations, the editor is blocked until they complete. */
+	Interactive,
+	/** Asynchronous operations initiated by the user, e.g. connecting or fetching history. */
+	UserVisible,
+	/** Asynchronous status refreshes the editor performs behind the scenes. */
+	Background,
+
+	Count
+};
+
+/** A set of thread pools owned by the Mercurial source control provider, one per lane. */
+class FCommandThreadPool
+{
+public:
+	FCommandThreadPool();
+	~FCommandThreadPool();
+
+	/** 
+	 * Create the threads for all the lanes, the number of threads in each lane is taken from 
+	 * the given settings.
+	 * @return true if all the lanes were created successfully, false otherwise.
+	 */
+	bool Create(const FProviderSettings& InSettings);
+
+	/** 
+	 * Destroy all the lanes. 
+	 * Any work that is still queued will be abandoned, this method blocks until work that is 
+	 * currently executing is done.
+	 */
+	void Destroy();
+
+	/** Return true iff Create() was successful and Destroy() hasn't been called since. */
+	bool IsValid() const
+	{
+		return bIsValid;
+	}
+
+	/** 
+	 * Queue work to be performed on one of the threads of the given lane.
+	 * @return true if the work was queued, false if the lanes haven't been created.
+	 */
+	bool AddQueuedWork(IQueuedWork* InWork, ECommandLane InLane);
+
+	/** 
+	 * Remove work that was queued in the given lane but hasn't started executing yet.
+	 * @return true if the work was removed, false if it wasn't in the queue.
+	 */
+	bool RetractQueuedWork(IQueuedWork* InWork, ECommandLane InLane);
+
+private:
+	FCommandThreadPool(const FCommandThreadPool&) = delete;
+	FCommandThreadPool& operator=(const FCommandThreadPool&) = delete;
+
+private:
+	FQueuedThreadPool* Lanes[(int32)ECommandLane::Count];
+	bool bIsValid;
+};
+
+} // namespace MercurialSourceControl
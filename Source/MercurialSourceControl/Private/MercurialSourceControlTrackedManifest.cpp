@@ -0,0 +1,237 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+
+#include "MercurialSourceControlPrivatePCH.h"
+#include "MercurialSourceControlTrackedManifest.h"
+
+namespace MercurialSourceControl {
+
+void FTrackedManifest::Reset(
+	const FString& InRepositoryRoot, const TArray<FPathId>& InTrackedFiles, 
+	const FRepositoryFingerprint& InFingerprint
+)
+{
+	const FPathId RootId = FPathTable::Get().Intern(InRepositoryRoot);
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	RepositoryRoot = InRepositoryRoot;
+	RepositoryRootId = RootId;
+	TrackedFiles.Empty(InTrackedFiles.Num());
+	DirectoryCounts.Empty();
+	DirectoryEntries.Empty();
+	for (const FPathId PathId : InTrackedFiles)
+	{
+		AddFile(PathId);
+	}
+	Fingerprint = InFingerprint;
+	bIsBuilt = true;
+}
+
+void FTrackedManifest::Empty()
+{
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	TrackedFiles.Empty();
+	DirectoryCounts.Empty();
+	DirectoryEntries.Empty();
+	Fingerprint = FRepositoryFingerprint();
+	RepositoryRoot.Empty();
+	RepositoryRootId = INDEX_NONE;
+	IgnoreMatcher.Reset();
+	bIsBuilt = false;
+}
+
+void FTrackedManifest::SetIgnoreMatcher(const FIgnoreMatcherPtr& InIgnoreMatcher)
+{
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	IgnoreMatcher = InIgnoreMatcher;
+}
+
+bool FTrackedManifest::IsBuilt() const
+{
+	FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+	return bIsBuilt;
+}
+
+FRepositoryFingerprint FTrackedManifest::GetFingerprint() const
+{
+	FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+	return Fingerprint;
+}
+
+ETrackedHint FTrackedManifest::GetHint(FPathId InPathId) const
+{
+	FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+	if (!bIsBuilt)
+	{
+		return ETrackedHint::None;
+	}
+	if (TrackedFiles.Contains(InPathId))
+	{
+		return ETrackedHint::Tracked;
+	}
+	// directories that contain tracked files aren't tracked themselves, but can't be added
+	if (DirectoryCounts.Contains(InPathId))
+	{
+		return ETrackedHint::None;
+	}
+
+	const FPathTable& PathTable = FPathTable::Get();
+	FPathId DirectoryId = PathTable.GetParent(InPathId);
+	while ((DirectoryId != INDEX_NONE) && (DirectoryId != RepositoryRootId))
+	{
+		DirectoryId = PathTable.GetParent(DirectoryId);
+	}
+	if (DirectoryId == INDEX_NONE)
+	{
+		// e.g. engine or plugin content, hg knows nothing about it
+		return ETrackedHint::None;
+	}
+
+	// a file that isn't tracked may well be ignored, and ignored files can't be added
+	if (!IgnoreMatcher.IsValid())
+	{
+		return ETrackedHint::None;
+	}
+	const FString RelativePath = PathTable.GetPath(InPathId).RightChop(RepositoryRoot.Len());
+	return IgnoreMatcher->IsIgnored(RelativePath) ? ETrackedHint::None : ETrackedHint::NotTracked;
+}
+
+void FTrackedManifest::Update(const TArray<TPair<FPathId, bool>>& InChanges)
+{
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	if (!bIsBuilt)
+	{
+		return;
+	}
+	for (const TPair<FPathId, bool>& Change : InChanges)
+	{
+		if (Change.Value)
+		{
+			AddFile(Change.Key);
+		}
+		else
+		{
+			RemoveFile(Change.Key);
+		}
+	}
+}
+
+int32 FTrackedManifest::GetNumTrackedFiles(FPathId InDirectoryId) const
+{
+	FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+	const int32* Count = DirectoryCounts.Find(InDirectoryId);
+	return Count ? *Count : 0;
+}
+
+void FTrackedManifest::GetTrackedFiles(FPathId InDirectoryId, TArray<FPathId>& OutFiles) const
+{
+	FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+	TArray<FPathId> Directories;
+	Directories.Add(InDirectoryId);
+	while (Directories.Num() > 0)
+	{
+		const TSet<FPathId>* Entries = DirectoryEntries.Find(Directories.Pop(false));
+		if (!Entries)
+		{
+			continue;
+		}
+		for (const FPathId Entry : *Entries)
+		{
+			if (TrackedFiles.Contains(Entry))
+			{
+				OutFiles.Add(Entry);
+			}
+			else
+			{
+				Directories.Add(Entry);
+			}
+		}
+	}
+}
+
+void FTrackedManifest::AddFile(FPathId InPathId)
+{
+	bool bAlreadyTracked = false;
+	TrackedFiles.Add(InPathId, &bAlreadyTracked);
+	if (bAlreadyTracked)
+	{
+		return;
+	}
+
+	// walk up the directory tree, each directory that didn't contain any tracked files 
+	// becomes an entry of its own parent
+	const FPathTable& PathTable = FPathTable::Get();
+	FPathId EntryId = InPathId;
+	bool bIsNewEntry = true;
+	for (FPathId DirectoryId = PathTable.GetParent(InPathId); DirectoryId != INDEX_NONE; 
+		DirectoryId = PathTable.GetParent(DirectoryId))
+	{
+		if (bIsNewEntry)
+		{
+			DirectoryEntries.FindOrAdd(DirectoryId).Add(EntryId);
+		}
+		int32& Count = DirectoryCounts.FindOrAdd(DirectoryId);
+		bIsNewEntry = (Count++ == 0);
+		EntryId = DirectoryId;
+	}
+}
+
+void FTrackedManifest::RemoveFile(FPathId InPathId)
+{
+	if (TrackedFiles.Remove(InPathId) == 0)
+	{
+		return;
+	}
+
+	// walk up the directory tree, each directory that no longer contains any tracked files 
+	// stops being an entry of its parent
+	const FPathTable& PathTable = FPathTable::Get();
+	FPathId EntryId = InPathId;
+	bool bIsEmptyEntry = true;
+	for (FPathId DirectoryId = PathTable.GetParent(InPathId); DirectoryId != INDEX_NONE; 
+		DirectoryId = PathTable.GetParent(DirectoryId))
+	{
+		if (bIsEmptyEntry)
+		{
+			TSet<FPathId>* Entries = DirectoryEntries.Find(DirectoryId);
+			if (Entries)
+			{
+				Entries->Remove(EntryId);
+			}
+		}
+		int32* Count = DirectoryCounts.Find(DirectoryId);
+		if (!Count)
+		{
+			break;
+		}
+		bIsEmptyEntry = (--(*Count) == 0);
+		if (bIsEmptyEntry)
+		{
+			DirectoryCounts.Remove(DirectoryId);
+			DirectoryEntries.Remove(DirectoryId);
+		}
+		EntryId = DirectoryId;
+	}
+}
+
+} // namespace MercurialSourceControl
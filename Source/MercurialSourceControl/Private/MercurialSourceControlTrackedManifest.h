@@ -0,0 +1,123 @@
+//-------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Vadim Macagon
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-------------------------------------------------------------------------------
+#pragma once
+
+#include "MercurialSourceControlFileState.h"
+#include "MercurialSourceControlCommandMemo.h"
+#include "MercurialSourceControlIgnoreMatcher.h"
+
+namespace MercurialSourceControl {
+
+/**
+ * In-memory set of all the files tracked in the working directory, which can say whether 
+ * a file is tracked without waiting for hg to report its status.
+ *
+ * The FPathTable already stores paths as a tree of path segments, so the manifest is a trie 
+ * laid over it: every directory that contains tracked files (directly, or within its 
+ * subdirectories) knows how many tracked files it contains, and which of its entries lead to 
+ * tracked files. That makes it cheap to tell whether a directory contains any tracked files, 
+ * and to enumerate the tracked files within a directory without scanning the whole manifest.
+ *
+ * The manifest is built from the dirstate (or hg files) when the provider connects, and then 
+ * kept up to date incrementally as file states are published to the file state cache.
+ * It's safe to use from any thread.
+ */
+class FTrackedManifest
+{
+public:
+	FTrackedManifest() : bIsBuilt(false), RepositoryRootId(INDEX_NONE) {}
+
+	/** 
+	 * Replace the contents of the manifest.
+	 * @param InRepositoryRoot Absolute path to the root of the repository, ending in a '/'.
+	 * @param InTrackedFiles IDs of the absolute filenames of all the tracked files.
+	 * @param InFingerprint Fingerprint of the repository the files were read from.
+	 */
+	void Reset(
+		const FString& InRepositoryRoot, const TArray<FPathId>& InTrackedFiles, 
+		const FRepositoryFingerprint& InFingerprint
+	);
+
+	/** 
+	 * Set the matcher used to tell ignored files apart from files that aren't tracked.
+	 * Without a matcher the manifest can only say which files are tracked.
+	 */
+	void SetIgnoreMatcher(const FIgnoreMatcherPtr& InIgnoreMatcher);
+
+	/** Remove everything from the manifest, it'll have no opinion until it's reset again. */
+	void Empty();
+
+	/** Check if the manifest has been built. */
+	bool IsBuilt() const;
+
+	/** Get the fingerprint of the repository the manifest was last built from. */
+	FRepositoryFingerprint GetFingerprint() const;
+
+	/** 
+	 * Check if the given file is tracked. The hint will be None if the manifest isn't built, and
+	 * for anything it can't be sure about: directories, paths outside the repository, and files
+	 * that may be ignored.
+	 */
+	ETrackedHint GetHint(FPathId InPathId) const;
+
+	/** 
+	 * Mark files as tracked or not tracked, does nothing if the manifest isn't built.
+	 * @param InChanges IDs of files, along with whether they're now tracked.
+	 */
+	void Update(const TArray<TPair<FPathId, bool>>& InChanges);
+
+	/** Get the number of tracked files within the given directory, including subdirectories. */
+	int32 GetNumTrackedFiles(FPathId InDirectoryId) const;
+
+	/** Get the IDs of all the tracked files within the given directory, and its subdirectories. */
+	void GetTrackedFiles(FPathId InDirectoryId, TArray<FPathId>& OutFiles) const;
+
+private:
+	/** @note The caller must hold a write lock. */
+	void AddFile(FPathId InPathId);
+
+	/** @note The caller must hold a write lock. */
+	void RemoveFile(FPathId InPathId);
+
+private:
+	mutable FRWLock Lock;
+	bool bIsBuilt;
+	FRepositoryFingerprint Fingerprint;
+	FString RepositoryRoot;
+	FPathId RepositoryRootId;
+	FIgnoreMatcherPtr IgnoreMatcher;
+
+	TSet<FPathId> TrackedFiles;
+
+	/** Number of tracked files within each directory that contains any. */
+	TMap<FPathId, int32> DirectoryCounts;
+
+	/** 
+	 * Entries (tracked files, and directories that contain tracked files) within each 
+	 * directory that contains any tracked files.
+	 */
+	TMap<FPathId, TSet<FPathId>> DirectoryEntries;
+};
+
+} // namespace MercurialSourceControl
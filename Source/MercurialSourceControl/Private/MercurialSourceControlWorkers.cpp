@@ -28,11 +28,166 @@
 #include "MercurialSourceControlClient.h"
 #include "MercurialSourceControlModule.h"
 #include "MercurialSourceControlCommand.h"
+#include "MercurialSourceControlFileStateCache.h"
+#include "MercurialSourceControlStateTransitions.h"
 
 namespace MercurialSourceControl {
 
 #define LOCTEXT_NAMESPACE "MercurialSourceControl.Workers"
 
+namespace 
+{
+	/** Get the states of all the files in the given content directory. */
+	bool GetContentDirectoryStates(
+		const FClient& InClient, const FString& InWorkingDirectory, 
+		const FString& InContentDirectory, TArray<FFileState>& OutFileStates, 
+		TArray<FString>& OutErrors
+	)
+	{
+		if (!InContentDirectory.StartsWith(InWorkingDirectory))
+		{
+			// TODO: localize the error message
+			OutErrors.Add(TEXT("Content directory is not in a repository."));
+			return false;
+		}
+
+		// "hg status ." is used when the content directory is the root of the repository
+		TArray<FString> Files;
+		Files.Add(
+			(InWorkingDirectory == InContentDirectory) ? 
+				InContentDirectory + TEXT(".") : InContentDirectory
+		);
+		return InClient.GetFileStates(InWorkingDirectory, Files, OutFileStates, OutErrors);
+	}
+
+	/** 
+	 * Rebuild the tracked manifest from the dirstate of the given repository, unless it's 
+	 * already been built from the current dirstate.
+	 */
+	void RefreshTrackedManifest(
+		const FClient& InClient, const FString& InRepositoryRoot, FFileStateCache& InFileStateCache
+	)
+	{
+		FTrackedManifest& Manifest = InFileStateCache.GetTrackedManifest();
+		// the ignore rules may change without the dirstate changing
+		Manifest.SetIgnoreMatcher(InClient.GetIgnoreMatcher(InRepositoryRoot));
+		const FRepositoryFingerprint Fingerprint = 
+			FRepositoryFingerprint::FromRepository(InRepositoryRoot);
+		if (Manifest.IsBuilt() && (Manifest.GetFingerprint() == Fingerprint))
+		{
+			return;
+		}
+
+		TArray<FString> Files;
+		TArray<FString> ErrorMessages;
+		if (!InClient.GetTrackedFiles(InRepositoryRoot, Files, ErrorMessages))
+		{
+			// the manifest is only a hint, the status of each file will be retrieved anyway
+			return;
+		}
+		TArray<FPathId> PathIds;
+		PathIds.Reserve(Files.Num());
+		FPathTable& PathTable = FPathTable::Get();
+		for (const FString& Filename : Files)
+		{
+			PathIds.Add(PathTable.Intern(InRepositoryRoot + Filename));
+		}
+		Manifest.Reset(InRepositoryRoot, PathIds, Fingerprint);
+	}
+
+	/**
+	 * Update the states of the given files after they've been mutated.
+	 * If the mutation succeeded the new states are predicted from the cached states, and hg is 
+	 * only asked about the files whose states can't be predicted, otherwise hg is asked about 
+	 * all the files. If the command was cancelled hg isn't asked about anything.
+	 * An empty file list means the whole repository was mutated (e.g. everything was 
+	 * committed), in which case hg is asked about everything in the content directory.
+	 * @param OutPredictedFiles The IDs of the files whose states were predicted (or couldn't be 
+	 *                          determined because the command was cancelled) will be appended
+	 *                          to this, their states should be verified later.
+	 */
+	bool UpdateMutatedStates(
+		const FClient& InClient, FCommand& InCommand, EFileMutation InMutation, 
+		const TArray<FString>& InAbsoluteFiles, bool bInMutationSucceeded, 
+		TArray<FPathId>& OutChangedFiles, TArray<FPathId>& OutPredictedFiles
+	)
+	{
+		if (InCommand.IsCancelRequested())
+		{
+			// hg may have been terminated part way through the mutation
+			for (const FString& Filename : InAbsoluteFiles)
+			{
+				OutPredictedFiles.Add(FPathTable::Get().Intern(Filename));
+			}
+			return false;
+		}
+
+		FFileStateCache& FileStateCache = InCommand.GetFileStateCache();
+		if (InAbsoluteFiles.Num() == 0)
+		{
+			// removed files won't show up in hg status anymore, so their states still have to 
+			// be predicted
+			if (bInMutationSucceeded)
+			{
+				TArray<FFileStateRef> RemovedStates;
+				FileStateCache.GetStatesWithStatus({ EFileStatus::Removed }, RemovedStates);
+				TArray<FString> RemovedFiles;
+				RemovedFiles.Reserve(RemovedStates.Num());
+				for (const FFileStateRef& RemovedState : RemovedStates)
+				{
+					RemovedState->GetFilename(RemovedFiles[RemovedFiles.AddDefaulted()]);
+				}
+				TArray<FString> UnpredictableFiles;
+				FStateTransitions::PublishPredictedStates(
+					InMutation, RemovedFiles, FileStateCache, OutChangedFiles, 
+					OutPredictedFiles, UnpredictableFiles
+				);
+			}
+
+			TArray<FFileState> FileStates;
+			const bool bResult = GetContentDirectoryStates(
+				InClient, InCommand.GetWorkingDirectory(), InCommand.GetContentDirectory(), 
+				FileStates, InCommand.ErrorMessages
+			);
+			FileStateCache.Update(FileStates, OutChangedFiles);
+			return bResult;
+		}
+
+		TArray<FString> FilesToQuery;
+		if (bInMutationSucceeded)
+		{
+			FStateTransitions::PublishPredictedStates(
+				InMutation, InAbsoluteFiles, FileStateCache, OutChangedFiles, OutPredictedFiles, 
+				FilesToQuery
+			);
+		}
+		else
+		{
+			FilesToQuery = InAbsoluteFiles;
+		}
+
+		if (FilesToQuery.Num() == 0)
+		{
+			return true;
+		}
+
+		TArray<FFileState> FileStates;
+		const bool bResult = InClient.GetFileStates(
+			InCommand.GetWorkingDirectory(), FilesToQuery, FileStates, InCommand.ErrorMessages
+		);
+		FileStateCache.Update(FileStates, OutChangedFiles);
+		return bResult;
+	}
+} // unnamed namespace
+
+FConnectWorker::FConnectWorker()
+	: TrustedExecutable(FModule::GetProvider().GetSettings().GetTrustedExecutable())
+	, TimeoutPolicy(FModule::GetProvider().GetSettings().GetTimeoutPolicy())
+	, bEnableFastProfile(FModule::GetProvider().GetSettings().IsFastProfileEnabled())
+	, bEnableChg(FModule::GetProvider().GetSettings().IsChgEnabled())
+{
+}
+
 FName FConnectWorker::GetName() const
 {
 	return OperationNames::Connect;
@@ -43,17 +198,10 @@ bool FConnectWorker::Execute(FCommand& InCommand)
 	check(InCommand.GetOperation()->GetName() == OperationNames::Connect);
 	check(InCommand.GetAbsoluteFiles().Num() == 1);
 
-	FText ErrorMessage;
 	TSharedRef<FConnect, ESPMode::ThreadSafe> Operation = 
 		StaticCastSharedRef<FConnect>(InCommand.GetOperation());
 
-	if (!FClient::Create(InCommand.GetAbsoluteFiles()[0], ErrorMessage))
-	{
-		Operation->SetErrorText(ErrorMessage);
-		return false;
-	}
-
-	if (!FClient::Get()->GetRepositoryRoot(InCommand.GetWorkingDirectory(), RepositoryRoot))
+	if (!FClient::GetRepositoryRoot(InCommand.GetWorkingDirectory(), RepositoryRoot))
 	{
 		Operation->SetErrorText(
 			FText::Format(
@@ -64,17 +212,63 @@ bool FConnectWorker::Execute(FCommand& InCommand)
 		return false;
 	}
 
+	const FText ExeNotFoundError = 
+		LOCTEXT("ExeNotFound", "Failed to locate a valid Mercurial executable.");
+	FString ExePath = InCommand.GetAbsoluteFiles()[0];
+	if (ExePath.IsEmpty() && !FClient::LocateExecutable(ExePath))
+	{
+		Operation->SetErrorText(ExeNotFoundError);
+		return false;
+	}
+
+	// Validating the executable means running it, which is only necessary if it has changed 
+	// since it was last validated. That has to be done before the client is created, the 
+	// provider is enabled (and so free to use the client) as soon as it is.
+	const FExecutableFingerprint Executable = FExecutableFingerprint::FromFile(ExePath);
+	if (!Executable.IsValid() || 
+		((Executable != TrustedExecutable) && !FClient::IsValidExecutable(ExePath)))
+	{
+		Operation->SetErrorText(ExeNotFoundError);
+		return false;
+	}
+	ValidatedExecutable = Executable;
+
+	FClient::Create(ExePath, TimeoutPolicy, bEnableChg, bEnableFastProfile, RepositoryRoot);
+	RefreshTrackedManifest(*FClient::Get(), RepositoryRoot, InCommand.GetFileStateCache());
+	TArray<FFileState> FileStates;
+	TArray<FString> ErrorMessages;
+	const bool bGotFileStates = GetContentDirectoryStates(
+		*FClient::Get(), RepositoryRoot, InCommand.GetContentDirectory(), FileStates, 
+		ErrorMessages
+	);
+
+	// failing to retrieve the states isn't fatal, the editor will request them again
+	if (bGotFileStates)
+	{
+		InCommand.GetFileStateCache().Update(FileStates, ChangedFiles);
+	}
+
 	return true;
 }
 
-bool FConnectWorker::UpdateStates() const
+bool FConnectWorker::UpdateStates(TArray<FPathId>& OutChangedFiles) const
 {
 	FProvider& Provider = FModule::GetProvider();
 	if (!RepositoryRoot.IsEmpty())
 	{
 		Provider.SetRepositoryRoot(RepositoryRoot);
 	}
-	return false;
+
+	// remember the executable so it doesn't need to be validated again next time
+	FProviderSettings& Settings = Provider.GetSettings();
+	if (ValidatedExecutable.IsValid() && (ValidatedExecutable != Settings.GetTrustedExecutable()))
+	{
+		Settings.SetTrustedExecutable(ValidatedExecutable);
+		Settings.Save();
+	}
+
+	OutChangedFiles.Append(ChangedFiles);
+	return ChangedFiles.Num() > 0;
 }
 
 FName FUpdateStatusWorker::GetName() const
@@ -96,32 +290,22 @@ bool FUpdateStatusWorker::Execute(FCommand& InCommand)
 		StaticCastSharedRef<FUpdateStatus>(InCommand.GetOperation());
 	
 	bool bResult = false;
+	TArray<FFileState> FileStates;
+	TMap<FString, TArray<FFileRevisionRef> > FileRevisionsMap;
 
 	if (Operation->ShouldGetOpenedOnly())
 	{
 		// What Perforce calls "opened" files roughly corresponds to files with an 
 		// added/modified/removed status in Mercurial. To keep things simple we'll just update
 		// the status of all the files in the current content directory.
-		TArray<FString> Files;
-		if (InCommand.GetWorkingDirectory() != InCommand.GetContentDirectory())
-		{
-			FString Directory = InCommand.GetContentDirectory();
-			if (FPaths::MakePathRelativeTo(Directory, *InCommand.GetWorkingDirectory()))
-			{
-				Files.Add(Directory);
-			}
-			else
-			{
-				// In this particular case the working directory should be the repository root, 
-				// if the content directory can't be made relative to the repository root then
-				// it's not in the repository!
-				// TODO: localize the error message
-				InCommand.ErrorMessages.Add(TEXT("Content directory is not in a repository."));
-				return false;
-			}
-		}
-		bResult = Client->GetFileStates(
-			InCommand.GetWorkingDirectory(), Files, FileStates, InCommand.ErrorMessages
+		// Files may have been added or removed outside the editor, so this is also a good time 
+		// to make sure the tracked manifest is up to date.
+		RefreshTrackedManifest(
+			*Client, InCommand.GetWorkingDirectory(), InCommand.GetFileStateCache()
+		);
+		bResult = GetContentDirectoryStates(
+			*Client, InCommand.GetWorkingDirectory(), InCommand.GetContentDirectory(), 
+			FileStates, InCommand.ErrorMessages
 		);
 	}
 	else if (InCommand.GetAbsoluteFiles().Num() > 0)
@@ -143,23 +327,24 @@ bool FUpdateStatusWorker::Execute(FCommand& InCommand)
 			InCommand.ErrorMessages
 		);
 	}
-	
-	return bResult;
-}
 
-bool FUpdateStatusWorker::UpdateStates() const
-{
-	FProvider& Provider = FModule::GetProvider();
-	bool bStatesUpdated = false;
+	FFileStateCache& FileStateCache = InCommand.GetFileStateCache();
 	if (FileStates.Num() > 0)
 	{
-		bStatesUpdated |= Provider.UpdateFileStateCache(FileStates);
+		FileStateCache.Update(FileStates, ChangedFiles);
 	}
 	if (FileRevisionsMap.Num() > 0)
 	{
-		bStatesUpdated |= Provider.UpdateFileStateCache(FileRevisionsMap);
+		FileStateCache.Update(FileRevisionsMap, ChangedFiles);
 	}
-	return bStatesUpdated;
+	
+	return bResult;
+}
+
+bool FUpdateStatusWorker::UpdateStates(TArray<FPathId>& OutChangedFiles) const
+{
+	OutChangedFiles.Append(ChangedFiles);
+	return ChangedFiles.Num() > 0;
 }
 
 FName FRevertWorker::GetName() const
@@ -181,17 +366,19 @@ bool FRevertWorker::Execute(FCommand& InCommand)
 		InCommand.GetWorkingDirectory(), InCommand.GetAbsoluteFiles(), InCommand.ErrorMessages
 	);
 
-	bResult &= Client->GetFileStates(
-		InCommand.GetWorkingDirectory(), InCommand.GetAbsoluteFiles(), FileStates,
-		InCommand.ErrorMessages
+	bResult &= UpdateMutatedStates(
+		*Client, InCommand, EFileMutation::Revert, InCommand.GetAbsoluteFiles(), bResult, 
+		ChangedFiles, PredictedFiles
 	);
 
 	return bResult;
 }
 
-bool FRevertWorker::UpdateStates() const
+bool FRevertWorker::UpdateStates(TArray<FPathId>& OutChangedFiles) const
 {
-	return FModule::GetProvider().UpdateFileStateCache(FileStates);
+	FModule::GetProvider().VerifyStatesLater(PredictedFiles);
+	OutChangedFiles.Append(ChangedFiles);
+	return ChangedFiles.Num() > 0;
 }
 
 FName FDeleteWorker::GetName() const
@@ -209,23 +396,63 @@ bool FDeleteWorker::Execute(FCommand& InCommand)
 		return false;
 	}
 
-	// NOTE: This will not remove files with an "added" status, but the Editor seems to revert
-	//       files before deleting them, so we shouldn't need to handle "added" files here.
-	bool bResult = Client->RemoveFiles(
-		InCommand.GetWorkingDirectory(), InCommand.GetAbsoluteFiles(), InCommand.ErrorMessages
-	);
+	// the client only needs to ask hg about the files whose status isn't cached
+	FFileStateCache& FileStateCache = InCommand.GetFileStateCache();
+	TArray<FFileState> FileStates;
+	FileStates.Reserve(InCommand.GetAbsoluteFiles().Num());
+	for (const FString& Filename : InCommand.GetAbsoluteFiles())
+	{
+		FileStates.Add(*FileStateCache.FindOrAdd(Filename));
+	}
 
-	bResult &= Client->GetFileStates(
-		InCommand.GetWorkingDirectory(), InCommand.GetAbsoluteFiles(), FileStates,
-		InCommand.ErrorMessages
+	TArray<FRemoveFileResult> Results;
+	bool bResult = Client->RemoveAllFiles(
+		InCommand.GetWorkingDirectory(), FileStates, Results, InCommand.ErrorMessages
 	);
 
+	// the outcome for each file is known, so the new states only need to be obtained from hg 
+	// for files that weren't removed
+	const FDateTime Now = FDateTime::Now();
+	TArray<FFileState> RemovedStates;
+	TArray<FString> FilesToQuery;
+	for (const FRemoveFileResult& Result : Results)
+	{
+		if (Result.bRemoved)
+		{
+			// added files are forgotten and deleted, anything else is marked as removed
+			FFileState RemovedState(Result.Filename);
+			RemovedState.SetFileStatus(
+				(Result.OldStatus == EFileStatus::Added) ? 
+					EFileStatus::NotTracked : EFileStatus::Removed
+			);
+			RemovedState.SetTimeStamp(Now);
+			RemovedStates.Add(RemovedState);
+			PredictedFiles.Add(RemovedState.GetPathId());
+		}
+		else
+		{
+			FilesToQuery.Add(Result.Filename);
+		}
+	}
+	FileStateCache.Update(RemovedStates, ChangedFiles);
+
+	if (FilesToQuery.Num() > 0)
+	{
+		TArray<FFileState> QueriedStates;
+		bResult &= Client->GetFileStates(
+			InCommand.GetWorkingDirectory(), FilesToQuery, QueriedStates, InCommand.ErrorMessages
+		);
+		FileStateCache.Update(QueriedStates, ChangedFiles);
+	}
+
 	return bResult;
 }
 
-bool FDeleteWorker::UpdateStates() const
+bool FDeleteWorker::UpdateStates(TArray<FPathId>& OutChangedFiles) const
 {
-	return FModule::GetProvider().UpdateFileStateCache(FileStates);
+	FModule::GetProvider().VerifyStatesLater(PredictedFiles);
+	OutChangedFiles.Append(ChangedFiles);
+	return ChangedFiles.Num() > 0;
 }
 
 FName FMarkForAddWorker::GetName() const
@@ -262,17 +489,21 @@ bool FMarkForAddWorker::Execute(FCommand& InCommand)
 		);
 	}
 
-	bResult &= Client->GetFileStates(
-		InCommand.GetWorkingDirectory(), InCommand.GetAbsoluteFiles(), FileStates,
-		InCommand.ErrorMessages
+	TArray<FString> AddedFiles = InCommand.GetAbsoluteFiles();
+	AddedFiles.Append(InCommand.GetAbsoluteLargeFiles());
+	bResult &= UpdateMutatedStates(
+		*Client, InCommand, EFileMutation::Add, AddedFiles, bResult, ChangedFiles, 
+		PredictedFiles
 	);
 
 	return bResult;
 }
 
-bool FMarkForAddWorker::UpdateStates() const
+bool FMarkForAddWorker::UpdateStates(TArray<FPathId>& OutChangedFiles) const
 {
-	return FModule::GetProvider().UpdateFileStateCache(FileStates);
+	FModule::GetProvider().VerifyStatesLater(PredictedFiles);
+	OutChangedFiles.Append(ChangedFiles);
+	return ChangedFiles.Num() > 0;
 }
 
 FName FCheckInWorker::GetName() const
@@ -318,17 +549,19 @@ bool FCheckInWorker::Execute(FCommand& InCommand)
 		);
 	}
 
-	bResult &= Client->GetFileStates(
-		InCommand.GetWorkingDirectory(), InCommand.GetAbsoluteFiles(), FileStates,
-		InCommand.ErrorMessages
+	bResult &= UpdateMutatedStates(
+		*Client, InCommand, EFileMutation::Commit, InCommand.GetAbsoluteFiles(), bResult, 
+		ChangedFiles, PredictedFiles
 	);
 
 	return bResult;
 }
 
-bool FCheckInWorker::UpdateStates() const
+bool FCheckInWorker::UpdateStates(TArray<FPathId>& OutChangedFiles) const
 {
-	return FModule::GetProvider().UpdateFileStateCache(FileStates);
+	FModule::GetProvider().VerifyStatesLater(PredictedFiles);
+	OutChangedFiles.Append(ChangedFiles);
+	return ChangedFiles.Num() > 0;
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -25,6 +25,7 @@
 
 #include "IMercurialSourceControlWorker.h"
 #include "MercurialSourceControlFileRevision.h"
+#include "MercurialSourceControlProviderSettings.h"
 
 namespace MercurialSourceControl {
 
@@ -32,18 +33,40 @@ class FCommand;
 class FFileState;
 
 /** 
- * Determines the location of the Mercurial repository root.
+ * Determines the location of the Mercurial repository root, and validates the Mercurial executable.
  * If the repository root is not found the Mercurial source control provider will not be enabled.
+ * The status of the files in the content directory is retrieved while the executable is being 
+ * validated, so that it's already cached by the time the editor asks for it.
  */
 class FConnectWorker : public IWorker
 {
 public:
+	FConnectWorker();
+
 	virtual FName GetName() const override;
 	virtual bool Execute(FCommand& InCommand) override;
-	virtual bool UpdateStates() const override;
+	virtual bool UpdateStates(TArray<FPathId>& OutChangedFiles) const override;
 
 private:
 	FString RepositoryRoot;
+
+	/** The executable that was validated during a previous connection (if any). */
+	FExecutableFingerprint TrustedExecutable;
+
+	/** The executable that was validated by Execute(). */
+	FExecutableFingerprint ValidatedExecutable;
+
+	/** Timeouts the client should apply to hg invocations. */
+	FTimeoutPolicy TimeoutPolicy;
+
+	/** Should the client run hg with the fast profile? */
+	bool bEnableFastProfile;
+
+	/** Should the client run hg through chg if it's available? */
+	bool bEnableChg;
+
+	/** IDs of the files whose state was changed by Execute(). */
+	TArray<FPathId> ChangedFiles;
 };
 
 /** 
@@ -55,11 +78,11 @@ class FUpdateStatusWorker : public IWorker
 public:
 	virtual FName GetName() const override;
 	virtual bool Execute(FCommand& InCommand) override;
-	virtual bool UpdateStates() const override;
+	virtual bool UpdateStates(TArray<FPathId>& OutChangedFiles) const override;
 
 private:
-	TArray<FFileState> FileStates;
-	TMap<FString, TArray<FFileRevisionRef> > FileRevisionsMap;
+	/** IDs of the files whose state was changed by Execute(). */
+	TArray<FPathId> ChangedFiles;
 };
 
 /** Reverts files back to the most recent revision in the repository. */
@@ -68,10 +91,14 @@ class FRevertWorker : public IWorker
 public:
 	virtual FName GetName() const;
 	virtual bool Execute(FCommand& InCommand);
-	virtual bool UpdateStates() const;
+	virtual bool UpdateStates(TArray<FPathId>& OutChangedFiles) const;
 
 private:
-	TArray<FFileState> FileStates;
+	/** IDs of the files whose state was changed by Execute(). */
+	TArray<FPathId> ChangedFiles;
+
+	/** IDs of the files whose state was predicted by Execute() rather than obtained from hg. */
+	TArray<FPathId> PredictedFiles;
 };
 
 /** Removes files from the repository. */
@@ -80,10 +107,14 @@ class FDeleteWorker : public IWorker
 public:
 	virtual FName GetName() const;
 	virtual bool Execute(FCommand& InCommand);
-	virtual bool UpdateStates() const;
+	virtual bool UpdateStates(TArray<FPathId>& OutChangedFiles) const;
 
 private:
-	TArray<FFileState> FileStates;
+	/** IDs of the files whose state was changed by Execute(). */
+	TArray<FPathId> ChangedFiles;
+
+	/** IDs of the files whose state was predicted by Execute() rather than obtained from hg. */
+	TArray<FPathId> PredictedFiles;
 };
 
 /** Marks files to be added to the repository. */
@@ -92,10 +123,14 @@ class FMarkForAddWorker : public IWorker
 public:
 	virtual FName GetName() const;
 	virtual bool Execute(FCommand& InCommand);
-	virtual bool UpdateStates() const;
+	virtual bool UpdateStates(TArray<FPathId>& OutChangedFiles) const;
 
 private:
-	TArray<FFileState> FileStates;
+	/** IDs of the files whose state was changed by Execute(). */
+	TArray<FPathId> ChangedFiles;
+
+	/** IDs of the files whose state was predicted by Execute() rather than obtained from hg. */
+	TArray<FPathId> PredictedFiles;
 };
 
 /** Commits files to the repository. */
@@ -104,10 +139,14 @@ class FCheckInWorker : public IWorker
 public:
 	virtual FName GetName() const;
 	virtual bool Execute(FCommand& InCommand);
-	virtual bool UpdateStates() const;
+	virtual bool UpdateStates(TArray<FPathId>& OutChangedFiles) const;
 
 private:
-	TArray<FFileState> FileStates;
+	/** IDs of the files whose state was changed by Execute(). */
+	TArray<FPathId> ChangedFiles;
+
+	/** IDs of the files whose state was predicted by Execute() rather than obtained from hg. */
+	TArray<FPathId> PredictedFiles;
 };
 
 } // namespace MercurialSourceControl
@@ -109,6 +109,21 @@ void SProviderSettingsWidget::Construct(const FArguments& InArgs)
 				]
 			]
 		]
+		// Active Client Mode
+		+SVerticalBox::Slot()
+		.AutoHeight()
+		.Padding(2.0f)
+		[
+			SNew(STextBlock)
+			.Text(this, &SProviderSettingsWidget::GetClientModeText)
+			.ToolTipText(
+				LOCTEXT(
+					"ClientMode_ToolTip",
+					"chg runs commands in a Mercurial command server that's kept running between commands, which is much faster than starting hg for every command."
+				)
+			)
+			.Font(TextFont)
+		]
 		// Enable Largefiles Integration Checkbox
 		+SVerticalBox::Slot()
 		.AutoHeight()
@@ -178,6 +193,18 @@ FText SProviderSettingsWidget::GetMercurialPathText() const
 	return MercurialPathText;
 }
 
+FText SProviderSettingsWidget::GetClientModeText() const
+{
+	const FClientSharedPtr Client = FClient::Get();
+	if (!Client.IsValid())
+	{
+		return LOCTEXT("ClientModeDisconnected", "Mode: not connected");
+	}
+	return Client->IsUsingChg() ? 
+		LOCTEXT("ClientModeChg", "Mode: chg (command server)") : 
+		LOCTEXT("ClientModeHg", "Mode: hg");
+}
+
 void SProviderSettingsWidget::MercurialPath_OnTextCommitted(
 	const FText& InText, ETextCommit::Type InCommitType
 )
@@ -40,6 +40,7 @@ private:
 	FText GetMercurialPathText() const;
 	void MercurialPath_OnTextCommitted(const FText& InText, ETextCommit::Type InCommitType);
 	FReply MercurialPathBrowse_OnClicked();
+	FText GetClientModeText() const;
 	EVisibility GetLargeAssetTypeTreeVisibility() const;
 	ECheckBoxState EnableLargefilesIntegration_IsChecked() const;
 	void EnableLargefilesIntegration_OnCheckStateChanged(ECheckBoxState NewState);